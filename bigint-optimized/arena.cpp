@@ -0,0 +1,81 @@
+#include "arena.h"
+
+#include <algorithm>
+#include <new>
+
+namespace {
+thread_local scoped_arena* innermost = nullptr;
+thread_local size_t pauses = 0;
+
+size_t const ALIGNMENT = alignof(std::max_align_t);
+
+size_t align_up(size_t bytes) {
+    return (bytes + ALIGNMENT - 1) / ALIGNMENT * ALIGNMENT;
+}
+}
+
+scoped_arena::scoped_arena(size_t block_size)
+        : head(nullptr), cursor(nullptr), limit(nullptr), block_size(std::max(block_size, ALIGNMENT)),
+          used_(0), reserved_(0), outer(innermost) {
+    innermost = this;
+}
+
+scoped_arena::~scoped_arena() {
+    innermost = outer;
+    while (head != nullptr) {
+        block* previous = head->previous;
+        ::operator delete(head);
+        head = previous;
+    }
+}
+
+size_t scoped_arena::used() const noexcept {
+    return used_;
+}
+
+size_t scoped_arena::reserved() const noexcept {
+    return reserved_;
+}
+
+scoped_arena* scoped_arena::current() noexcept {
+    return pauses > 0 ? nullptr : innermost;
+}
+
+void* scoped_arena::allocate(size_t bytes) {
+    bytes = align_up(bytes);
+    if (cursor == nullptr || static_cast<size_t>(limit - cursor) < bytes) {
+        add_block(bytes);
+    }
+    void* result = cursor;
+    cursor += bytes;
+    used_ += bytes;
+    return result;
+}
+
+void scoped_arena::deallocate(void* p, size_t bytes) noexcept {
+    // Only the thread bumping the cursor may move it back.
+    if (this == innermost && static_cast<char*>(p) + align_up(bytes) == cursor) {
+        cursor = static_cast<char*>(p);
+        used_ -= align_up(bytes);
+    }
+}
+
+void scoped_arena::add_block(size_t bytes) {
+    size_t header = align_up(sizeof(block));
+    size_t size = header + std::max(bytes, block_size);
+    block* fresh = static_cast<block*>(::operator new(size));
+    fresh->previous = head;
+    fresh->size = size;
+    head = fresh;
+    cursor = reinterpret_cast<char*>(fresh) + header;
+    limit = reinterpret_cast<char*>(fresh) + size;
+    reserved_ += size;
+}
+
+arena_pause::arena_pause() noexcept {
+    pauses++;
+}
+
+arena_pause::~arena_pause() {
+    pauses--;
+}
@@ -0,0 +1,122 @@
+#ifndef BIGINT_ARENA_H
+#define BIGINT_ARENA_H
+
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+#include <vector>
+#include "instrumentation.h"
+#include "pool.h"
+
+// Bump region for short-lived limb buffers. While a scoped_arena is alive, the scratch limbs
+// that operators need on the same thread (normalized operands of long division, Karatsuba sums,
+// conversion remainders) are carved from it; deallocation is free and the whole region is
+// released when the scope ends. Arenas nest.
+//
+// Numbers themselves never hold arena memory: their limbs come from size_class_pool, so a number
+// made inside the scope may be moved, assigned or returned out of it like any other.
+struct scoped_arena {
+    static const size_t DEFAULT_BLOCK_SIZE = 64 * 1024;
+
+    explicit scoped_arena(size_t block_size = DEFAULT_BLOCK_SIZE);
+
+    scoped_arena(scoped_arena const& other) = delete;
+
+    scoped_arena& operator=(scoped_arena const& other) = delete;
+
+    ~scoped_arena();
+
+    // Bytes handed out so far and bytes requested from the global heap.
+    size_t used() const noexcept;
+
+    size_t reserved() const noexcept;
+
+    // The innermost arena of the calling thread, or null outside of arenas and under a pause.
+    static scoped_arena* current() noexcept;
+
+    void* allocate(size_t bytes);
+
+    // Freeing the latest allocation of the innermost arena on its thread gives the space back,
+    // anything else waits for the scope end.
+    void deallocate(void* p, size_t bytes) noexcept;
+
+private:
+    struct block {
+        block* previous;
+        size_t size;
+    };
+
+    block* head;
+    char* cursor;
+    char* limit;
+    size_t block_size;
+    size_t used_;
+    size_t reserved_;
+    scoped_arena* outer;
+
+    void add_block(size_t bytes);
+};
+
+// Routes scratch allocations of the current thread back to the heap until destroyed.
+struct arena_pause {
+    arena_pause() noexcept;
+
+    arena_pause(arena_pause const& other) = delete;
+
+    arena_pause& operator=(arena_pause const& other) = delete;
+
+    ~arena_pause();
+};
+
+// Allocates from the arena it was created for, or from size_class_pool if none, which is the
+// default and what every number uses. Containers take the allocator along when moved.
+template<typename T>
+struct arena_allocator {
+    using value_type = T;
+    using propagate_on_container_move_assignment = std::true_type;
+    using propagate_on_container_swap = std::true_type;
+
+    arena_allocator() noexcept = default;
+
+    explicit arena_allocator(scoped_arena* arena) noexcept : arena(arena) {}
+
+    template<typename U>
+    arena_allocator(arena_allocator<U> const& other) noexcept : arena(other.arena) {}
+
+    T* allocate(size_t n) {
+        BIGINT_COUNT_ALLOCATION();
+        size_t bytes = n * sizeof(T);
+        return static_cast<T*>(arena == nullptr ? size_class_pool::allocate(bytes) : arena->allocate(bytes));
+    }
+
+    void deallocate(T* p, size_t n) noexcept {
+        if (arena == nullptr) {
+            size_class_pool::deallocate(p, n * sizeof(T));
+        } else {
+            arena->deallocate(p, n * sizeof(T));
+        }
+    }
+
+    friend bool operator==(arena_allocator const& a, arena_allocator const& b) noexcept {
+        return a.arena == b.arena;
+    }
+
+    friend bool operator!=(arena_allocator const& a, arena_allocator const& b) noexcept {
+        return a.arena != b.arena;
+    }
+
+private:
+    template<typename U>
+    friend struct arena_allocator;
+
+    scoped_arena* arena = nullptr;
+};
+
+// Limbs that do not leave the function that made them: inside an arena they come from it.
+using scratch_limbs = std::vector<uint32_t, arena_allocator<uint32_t>>;
+
+inline scratch_limbs scratch(size_t n) {
+    return scratch_limbs(n, arena_allocator<uint32_t>(scoped_arena::current()));
+}
+
+#endif //BIGINT_ARENA_H
@@ -2,6 +2,7 @@
 #define BIG_INTEGER_GMP_H
 
 #include <cstddef>
+#include <functional>
 #include <gmp.h>
 #include <iosfwd>
 
@@ -60,6 +61,8 @@ struct big_integer_gmp {
 
   friend std::string to_string(big_integer_gmp const& a);
 
+  friend struct std::hash<big_integer_gmp>;
+
  private:
   mpz_t mpz;
 };
@@ -87,4 +90,10 @@ bool operator>=(big_integer_gmp const& a, big_integer_gmp const& b);
 std::string to_string(big_integer_gmp const& a);
 std::ostream& operator<<(std::ostream& s, big_integer_gmp const& a);
 
+// std::hash of the limb bytes, negated for negative numbers; the baseline of the hash benchmark.
+template<>
+struct std::hash<big_integer_gmp> {
+  size_t operator()(big_integer_gmp const& a) const noexcept;
+};
+
 #endif // BIG_INTEGER_GMP_H
\ No newline at end of file
@@ -0,0 +1,372 @@
+#include "decimal.h"
+
+#include <algorithm>
+#include <cstring>
+#include <future>
+#include <string>
+#include <vector>
+
+#include "arena.h"
+#include "limbs.h"
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+namespace {
+#ifdef __SSE2__
+// Eight digits of value < 10^8 as 16-bit lanes, most significant first (W. Mula's SSE2 itoa):
+// value is split into two halves below 10^4, each half is broadcast to four lanes that are
+// divided by 10^3, 10^2, 10^1 and 10^0 with multiply-high, and subtracting ten times the
+// neighbouring lane leaves one digit per lane.
+__m128i eight_digits(uint32_t value) {
+    const __m128i div_powers = _mm_setr_epi16(8389, 5243, 13108, -32768, 8389, 5243, 13108, -32768);
+    const __m128i shift_powers = _mm_setr_epi16(1 << 7, 1 << 11, 1 << 13, -32768, 1 << 7, 1 << 11, 1 << 13, -32768);
+    __m128i whole = _mm_cvtsi32_si128(static_cast<int>(value));
+    // value / 10^4 by multiplication with 2^45 / 10^4, rounded up.
+    __m128i high = _mm_srli_epi64(_mm_mul_epu32(whole, _mm_set1_epi32(static_cast<int>(0xd1b71759))), 45);
+    __m128i low = _mm_sub_epi32(whole, _mm_mul_epu32(high, _mm_set1_epi32(10000)));
+    __m128i halves = _mm_slli_epi64(_mm_unpacklo_epi16(high, low), 2);
+    __m128i spread = _mm_unpacklo_epi32(_mm_unpacklo_epi16(halves, halves), _mm_unpacklo_epi16(halves, halves));
+    __m128i prefixes = _mm_mulhi_epu16(_mm_mulhi_epu16(spread, div_powers), shift_powers);
+    __m128i tens = _mm_slli_epi64(_mm_mullo_epi16(prefixes, _mm_set1_epi16(10)), 16);
+    return _mm_sub_epi16(prefixes, tens);
+}
+#endif
+
+// Below these sizes conversion runs chunk by chunk, and splits stay on the calling thread.
+const size_t BASE_CHUNKS = 16;
+const size_t PARALLEL_CHUNKS = 4096;
+
+using power_table = std::vector<std::vector<uint32_t>>;
+
+size_t trimmed(uint32_t const* a, size_t n) {
+    while (n > 0 && a[n - 1] == 0) {
+        n--;
+    }
+    return n;
+}
+
+// Extends powers[k] = CHUNK^(2^k) to at least levels entries.
+void extend(power_table& powers, size_t levels, unsigned threads) {
+    if (powers.empty()) {
+        powers.emplace_back(1, decimal::CHUNK);
+    }
+    while (powers.size() < levels) {
+        size_t n = powers.back().size();
+        std::vector<uint32_t> square(2 * n);
+        limbs::mul(square.data(), powers.back().data(), n, powers.back().data(), n, threads);
+        square.resize(trimmed(square.data(), square.size()));
+        powers.push_back(std::move(square));
+    }
+}
+
+// powers[k] = CHUNK^(2^k) for every 2^k < chunks. Empty up to BASE_CHUNKS, where conversion
+// never splits, so that short numbers are converted without allocating.
+power_table powers_below(size_t chunks, unsigned threads) {
+    power_table powers;
+    if (chunks <= BASE_CHUNKS) {
+        return powers;
+    }
+    size_t levels = 1;
+    while ((static_cast<size_t>(1) << levels) < chunks) {
+        levels++;
+    }
+    extend(powers, levels, threads);
+    return powers;
+}
+
+// The largest level whose power leaves a non-empty high part of chunks.
+size_t split_level(size_t chunks) {
+    size_t level = 0;
+    while ((static_cast<size_t>(2) << level) < chunks) {
+        level++;
+    }
+    return level;
+}
+
+// a[0, n) divided by power with n >= power.size(): the quotient goes to quotient[0, n + 1 - size)
+// and the remainder to rest[0, size); rest must have room for n + 1 limbs.
+void divide_by_power(uint32_t* quotient, uint32_t* rest, uint32_t const* a, size_t n,
+                     std::vector<uint32_t> const& power) {
+    size_t size = power.size();
+    // Same scaling as in big_integer::divide: the top bit of the divisor must be set.
+    unsigned shift = 0;
+    while ((power[size - 1] << shift & 0x80000000u) == 0) {
+        shift++;
+    }
+    scratch_limbs divisor = scratch(size);
+    limbs::lshift(divisor.data(), power.data(), size, shift);
+    rest[n] = limbs::lshift(rest, a, n, shift);
+    limbs::divrem(quotient, rest, n + 1, divisor.data(), size);
+    limbs::rshift(rest, rest, size, shift);
+}
+
+void write_chunks(char* out, size_t chunks, uint32_t* a, size_t n, power_table const& powers, unsigned threads) {
+    n = trimmed(a, n);
+    if (chunks <= BASE_CHUNKS) {
+        for (size_t i = chunks; i-- > 0;) {
+            decimal::write_chunk(out + i * decimal::CHUNK_DIGITS, limbs::divrem_1(a, a, n, decimal::CHUNK));
+            n = trimmed(a, n);
+        }
+        return;
+    }
+    size_t level = split_level(chunks);
+    size_t low = static_cast<size_t>(1) << level;
+    size_t high = chunks - low;
+    char* low_out = out + high * decimal::CHUNK_DIGITS;
+    std::vector<uint32_t> const& power = powers[level];
+    size_t size = power.size();
+    if (n < size) {
+        std::memset(out, '0', high * decimal::CHUNK_DIGITS);
+        write_chunks(low_out, low, a, n, powers, threads);
+        return;
+    }
+    scratch_limbs rest = scratch(n + 1);
+    scratch_limbs quotient = scratch(n + 1 - size);
+    divide_by_power(quotient.data(), rest.data(), a, n, power);
+    if (threads > 1 && chunks >= PARALLEL_CHUNKS) {
+        std::future<void> upper = std::async(std::launch::async, write_chunks, out, high, quotient.data(),
+                                             quotient.size(), std::cref(powers), threads / 2);
+        write_chunks(low_out, low, rest.data(), size, powers, threads - threads / 2);
+        upper.get();
+    } else {
+        write_chunks(out, high, quotient.data(), quotient.size(), powers, threads);
+        write_chunks(low_out, low, rest.data(), size, powers, threads);
+    }
+}
+
+void write_zeros(decimal::digit_sink const& out, size_t count, size_t after) {
+    char zeros[BASE_CHUNKS * decimal::CHUNK_DIGITS];
+    std::memset(zeros, '0', sizeof(zeros));
+    while (count > 0) {
+        size_t taken = std::min(count, sizeof(zeros));
+        count -= taken;
+        out(zeros, taken, count + after);
+    }
+}
+
+// write_chunks on one thread that hands every BASE_CHUNKS or fewer chunks to out as soon as they
+// are written; after digits follow the chunks.
+void write_pieces(decimal::digit_sink const& out, size_t after, size_t chunks, uint32_t* a, size_t n,
+                  power_table const& powers) {
+    n = trimmed(a, n);
+    if (chunks <= BASE_CHUNKS) {
+        char text[BASE_CHUNKS * decimal::CHUNK_DIGITS];
+        write_chunks(text, chunks, a, n, powers, 1);
+        out(text, chunks * decimal::CHUNK_DIGITS, after);
+        return;
+    }
+    size_t level = split_level(chunks);
+    size_t low = static_cast<size_t>(1) << level;
+    size_t high = chunks - low;
+    size_t low_digits = low * decimal::CHUNK_DIGITS;
+    std::vector<uint32_t> const& power = powers[level];
+    size_t size = power.size();
+    if (n < size) {
+        write_zeros(out, high * decimal::CHUNK_DIGITS, after + low_digits);
+        write_pieces(out, after, low, a, n, powers);
+        return;
+    }
+    scratch_limbs rest = scratch(n + 1);
+    scratch_limbs quotient = scratch(n + 1 - size);
+    divide_by_power(quotient.data(), rest.data(), a, n, power);
+    write_pieces(out, after + low_digits, high, quotient.data(), quotient.size(), powers);
+    write_pieces(out, after, low, rest.data(), size, powers);
+}
+
+// r = upper * power + lower with lower < power, returns the size of r without leading zero limbs.
+// r must have room for upper_size + power.size() limbs and must not overlap the operands.
+size_t join(uint32_t* r, uint32_t const* upper, size_t upper_size, std::vector<uint32_t> const& power,
+            uint32_t const* lower, size_t lower_size, unsigned threads) {
+    if (upper_size == 0) {
+        std::copy(lower, lower + lower_size, r);
+        return lower_size;
+    }
+    size_t size = upper_size + power.size();
+    limbs::mul(r, upper, upper_size, power.data(), power.size(), threads);
+    uint32_t carry = limbs::add_n(r, r, lower, lower_size);
+    limbs::add_1(r + lower_size, r + lower_size, size - lower_size, carry);
+    return trimmed(r, size);
+}
+
+size_t read_chunks(uint32_t* r, char const* digits, size_t count, power_table const& powers, unsigned threads) {
+    if (count <= BASE_CHUNKS * decimal::CHUNK_DIGITS) {
+        size_t n = 0;
+        size_t length = (count - 1) % decimal::CHUNK_DIGITS + 1;
+        for (size_t begin = 0; begin < count; begin += length, length = decimal::CHUNK_DIGITS) {
+            uint32_t chunk = 0;
+            uint32_t scale = 1;
+            for (size_t i = begin; i < begin + length; i++) {
+                chunk = chunk * 10 + static_cast<uint32_t>(digits[i] - '0');
+                scale *= 10;
+            }
+            uint32_t carry = limbs::mul_1(r, r, n, scale);
+            carry += limbs::add_1(r, r, n, chunk);
+            if (carry > 0) {
+                r[n++] = carry;
+            }
+        }
+        return n;
+    }
+    size_t level = split_level((count + decimal::CHUNK_DIGITS - 1) / decimal::CHUNK_DIGITS);
+    size_t low = decimal::CHUNK_DIGITS << level;
+    size_t high = count - low;
+    scratch_limbs upper = scratch(decimal::limbs_for(high));
+    scratch_limbs lower = scratch(decimal::limbs_for(low));
+    size_t upper_size;
+    size_t lower_size;
+    if (threads > 1 && count >= PARALLEL_CHUNKS * decimal::CHUNK_DIGITS) {
+        std::future<size_t> pending = std::async(std::launch::async, read_chunks, upper.data(), digits, high,
+                                                 std::cref(powers), threads / 2);
+        lower_size = read_chunks(lower.data(), digits + high, low, powers, threads - threads / 2);
+        upper_size = pending.get();
+    } else {
+        upper_size = read_chunks(upper.data(), digits, high, powers, threads);
+        lower_size = read_chunks(lower.data(), digits + high, low, powers, threads);
+    }
+    return join(r, upper.data(), upper_size, powers[level], lower.data(), lower_size, threads);
+}
+
+// Parts of a stream are converted BLOCK_DIGITS = CHUNK_DIGITS << BLOCK_LEVEL digits at a time.
+const size_t BLOCK_LEVEL = 12;
+
+static_assert(decimal::accumulator::BLOCK_DIGITS == decimal::CHUNK_DIGITS << BLOCK_LEVEL,
+              "a block is a power of two chunks");
+
+std::vector<uint32_t> read_block(char const* digits, size_t count, power_table const& powers) {
+    std::vector<uint32_t> result(decimal::limbs_for(count));
+    result.resize(read_chunks(result.data(), digits, count, powers, 1));
+    return result;
+}
+
+std::vector<uint32_t> join(std::vector<uint32_t> const& upper, std::vector<uint32_t> const& power,
+                           std::vector<uint32_t> const& lower) {
+    std::vector<uint32_t> result(std::max(upper.size() + power.size(), lower.size()));
+    result.resize(join(result.data(), upper.data(), upper.size(), power, lower.data(), lower.size(), 1));
+    return result;
+}
+}
+
+void decimal::write_chunk(char* out, uint32_t chunk) {
+#ifdef __SSE2__
+    uint32_t tail = chunk % 100000000;
+    out[0] = static_cast<char>('0' + chunk / 100000000);
+    __m128i bytes = _mm_packus_epi16(eight_digits(tail), _mm_setzero_si128());
+    _mm_storel_epi64(reinterpret_cast<__m128i*>(out + 1), _mm_add_epi8(bytes, _mm_set1_epi8('0')));
+#else
+    for (size_t i = CHUNK_DIGITS; i-- > 0;) {
+        out[i] = static_cast<char>('0' + chunk % 10);
+        chunk /= 10;
+    }
+#endif
+}
+
+size_t decimal::digits(uint32_t chunk) {
+    size_t result = 1;
+    for (uint32_t power = 10; result < CHUNK_DIGITS && chunk >= power; power *= 10) {
+        result++;
+    }
+    return result;
+}
+
+size_t decimal::write_leading_chunk(char* out, uint32_t chunk) {
+    char buffer[CHUNK_DIGITS];
+    write_chunk(buffer, chunk);
+    size_t count = digits(chunk);
+    std::memcpy(out, buffer + CHUNK_DIGITS - count, count);
+    return count;
+}
+
+size_t decimal::chunks_for(size_t n) {
+    // 32 * log10(2) < 9.633 digits per limb.
+    return (n * 9633 / 1000 + 1) / CHUNK_DIGITS + 1;
+}
+
+size_t decimal::limbs_for(size_t count) {
+    return (count + CHUNK_DIGITS - 1) / CHUNK_DIGITS;
+}
+
+void decimal::to_digits(char* out, size_t chunks, uint32_t* a, size_t n, unsigned threads) {
+    write_chunks(out, chunks, a, n, powers_below(chunks, threads), std::max(threads, 1u));
+}
+
+void decimal::to_digits(digit_sink const& out, size_t chunks, uint32_t* a, size_t n) {
+    write_pieces(out, 0, chunks, a, n, powers_below(chunks, 1));
+}
+
+size_t decimal::from_digits(uint32_t* r, char const* digits, size_t count, unsigned threads) {
+    return read_chunks(r, digits, count, powers_below(limbs_for(count), threads), std::max(threads, 1u));
+}
+
+void decimal::accumulator::append(char const* digits, size_t count) {
+    if (pending.empty()) {
+        for (; count >= BLOCK_DIGITS; digits += BLOCK_DIGITS, count -= BLOCK_DIGITS) {
+            push_block(digits);
+        }
+    }
+    while (count > 0) {
+        size_t taken = std::min(count, BLOCK_DIGITS - pending.size());
+        pending.insert(pending.end(), digits, digits + taken);
+        digits += taken;
+        count -= taken;
+        if (pending.size() == BLOCK_DIGITS) {
+            push_block(pending.data());
+            pending.clear();
+        }
+    }
+}
+
+// Like the carries of a binary counter: a new block merges with the last part while both
+// stand for the same number of digits.
+void decimal::accumulator::push_block(char const* digits) {
+    extend(powers, BLOCK_LEVEL + 1, 1);
+    part block{read_block(digits, BLOCK_DIGITS, powers), 0};
+    while (!parts.empty() && parts.back().level == block.level) {
+        extend(powers, BLOCK_LEVEL + block.level + 1, 1);
+        block.value = join(parts.back().value, powers[BLOCK_LEVEL + block.level], block.value);
+        block.level++;
+        parts.pop_back();
+    }
+    parts.push_back(std::move(block));
+}
+
+size_t decimal::accumulator::limbs() const {
+    size_t count = pending.size();
+    for (part const& p : parts) {
+        count += BLOCK_DIGITS << p.level;
+    }
+    // The last join needs room for the product of the upper digits and a power of ten.
+    return limbs_for(count) + 2;
+}
+
+// Every join but the last goes through a temporary, the last one writes r.
+size_t decimal::accumulator::finish(uint32_t* r) {
+    size_t size = 0;
+    std::vector<uint32_t> upper;
+    size_t joined = pending.empty() && !parts.empty() ? parts.size() - 1 : parts.size();
+    for (size_t i = 0; i < joined; i++) {
+        extend(powers, BLOCK_LEVEL + parts[i].level + 1, 1);
+        upper = join(upper, powers[BLOCK_LEVEL + parts[i].level], parts[i].value);
+    }
+    if (joined < parts.size()) {
+        part const& last = parts.back();
+        extend(powers, BLOCK_LEVEL + last.level + 1, 1);
+        size = join(r, upper.data(), upper.size(), powers[BLOCK_LEVEL + last.level], last.value.data(),
+                    last.value.size(), 1);
+    } else if (!pending.empty()) {
+        extend(powers, BLOCK_LEVEL + 1, 1);
+        if (parts.empty()) {
+            size = read_chunks(r, pending.data(), pending.size(), powers, 1);
+        } else {
+            std::vector<uint32_t> tail = read_block(pending.data(), pending.size(), powers);
+            std::string scale(pending.size() + 1, '0');
+            scale[0] = '1';
+            size = join(r, upper.data(), upper.size(), read_block(scale.data(), scale.size(), powers), tail.data(),
+                        tail.size(), 1);
+        }
+    }
+    parts.clear();
+    pending.clear();
+    return size;
+}
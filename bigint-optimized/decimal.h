@@ -0,0 +1,76 @@
+#ifndef BIGINT_DECIMAL_H
+#define BIGINT_DECIMAL_H
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+// Conversion between ASCII digits and chunks of CHUNK_DIGITS decimal digits, the largest
+// power of ten that fits a limb.
+namespace decimal {
+const size_t CHUNK_DIGITS = 9;
+const uint32_t CHUNK = 1000000000;
+
+// Writes chunk < CHUNK as exactly CHUNK_DIGITS digits, with leading zeros.
+void write_chunk(char* out, uint32_t chunk);
+
+// Number of digits of chunk without leading zeros (1 for zero).
+size_t digits(uint32_t chunk);
+
+// Writes chunk without leading zeros, returns the number of digits written.
+size_t write_leading_chunk(char* out, uint32_t chunk);
+
+// Number of chunks that holds any value of n limbs.
+size_t chunks_for(size_t n);
+
+// Number of limbs that holds any value of count digits.
+size_t limbs_for(size_t count);
+
+// Writes a[0, n) < CHUNK^chunks as exactly chunks * CHUNK_DIGITS digits, with leading zeros;
+// a is clobbered. Divide and conquer by powers CHUNK^(2^k): the quotient and the remainder
+// of each split go to disjoint parts of out, on separate threads while threads allow.
+void to_digits(char* out, size_t chunks, uint32_t* a, size_t n, unsigned threads);
+
+// Receives count digits of a number, with after more digits still to come.
+using digit_sink = std::function<void(char const* digits, size_t count, size_t after)>;
+
+// to_digits for output that is taken piece by piece, e.g. by a stream: the same digits go to out
+// in order, at most a few hundred at a time, so they are never held all at once.
+void to_digits(digit_sink const& out, size_t chunks, uint32_t* a, size_t n);
+
+// Reads count > 0 digits into r[0, limbs_for(count)), returns the size without leading zero
+// limbs. The high and low parts of each split are read concurrently, like in to_digits.
+size_t from_digits(uint32_t* r, char const* digits, size_t count, unsigned threads);
+
+// from_digits for digits that arrive in pieces, e.g. from a stream. Every BLOCK_DIGITS digits
+// are converted as soon as they are complete, and parts standing for equal numbers of digits
+// are merged, so the digits are never held all at once and the cost stays that of from_digits.
+struct accumulator {
+    static const size_t BLOCK_DIGITS = CHUNK_DIGITS << 12;
+
+    void append(char const* digits, size_t count);
+
+    // Room that finish needs for the value of all digits appended so far.
+    size_t limbs() const;
+
+    // Writes the value of all digits appended so far to r[0, limbs()), returns its size without
+    // leading zero limbs; empties the accumulator.
+    size_t finish(uint32_t* r);
+
+private:
+    // The value of BLOCK_DIGITS << level digits.
+    struct part {
+        std::vector<uint32_t> value;
+        size_t level;
+    };
+
+    std::vector<char> pending;
+    std::vector<part> parts;
+    std::vector<std::vector<uint32_t>> powers;
+
+    void push_block(char const* digits);
+};
+}
+
+#endif //BIGINT_DECIMAL_H
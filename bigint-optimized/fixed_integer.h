@@ -0,0 +1,538 @@
+#ifndef BIGINT_FIXED_INTEGER_H
+#define BIGINT_FIXED_INTEGER_H
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <string_view>
+
+// True while the compiler evaluates a constant expression (std::is_constant_evaluated in C++20).
+#define BIGINT_CONSTANT_EVALUATED() __builtin_is_constant_evaluated()
+
+// Deliberately not constexpr: fixed_integer calls it only when arithmetic in a constant expression
+// overflows, which makes the overflow a compile error.
+inline void fixed_integer_overflow() {}
+
+// Two's complement integer of exactly Bits bits. Arithmetic wraps modulo 2^Bits at run time;
+// in constant expressions signed overflow of +, -, *, / and negation does not compile, like for
+// the built-in signed types. All loops run over the compile-time limb count, so there is no heap,
+// no normalization and no size checks.
+template<size_t Bits>
+struct fixed_integer {
+    static_assert(Bits > 0 && Bits % 32 == 0, "fixed_integer width must be a positive multiple of 32");
+
+    static constexpr size_t ELEMENT_LENGTH = 32;
+    static constexpr size_t LIMBS = Bits / ELEMENT_LENGTH;
+
+    constexpr fixed_integer() : number() {}
+
+    constexpr fixed_integer(int a) : number() {
+        number[0] = static_cast<uint32_t>(a);
+        for (size_t i = 1; i < LIMBS; i++) {
+            number[i] = a < 0 ? UINT32_MAX : 0;
+        }
+    }
+
+    constexpr fixed_integer(unsigned a) : number() {
+        number[0] = a;
+    }
+
+    // Digit separators (') are skipped, so the text of a literal can be passed as is.
+    explicit constexpr fixed_integer(std::string_view str) : number() {
+        if (str.empty()) {
+            return;
+        }
+        bool csign = str[0] == '-';
+        size_t i = csign;
+        while (i < str.size()) {
+            uint32_t chunk = 0;
+            uint32_t power = 1;
+            for (size_t digits = 0; digits < 9 && i < str.size(); i++) {
+                if (str[i] != '\'') {
+                    chunk = chunk * 10 + (str[i] - '0');
+                    power *= 10;
+                    digits++;
+                }
+            }
+            mul_small(power);
+            add_small(chunk);
+        }
+        if (csign) {
+            negate();
+        }
+    }
+
+    // Sign-extends or truncates a value of another width.
+    template<size_t OtherBits>
+    explicit constexpr fixed_integer(fixed_integer<OtherBits> const& other) : number() {
+        uint32_t fill = other.is_negative() ? UINT32_MAX : 0;
+        for (size_t i = 0; i < LIMBS; i++) {
+            number[i] = i < other.LIMBS ? other.data()[i] : fill;
+        }
+    }
+
+    fixed_integer(fixed_integer const& other) = default;
+
+    fixed_integer& operator=(fixed_integer const& other) = default;
+
+    constexpr fixed_integer& operator+=(fixed_integer const& rhs) {
+        bool negative = is_negative();
+        bool rhs_negative = rhs.is_negative();
+        uint64_t carry = 0;
+        for (size_t i = 0; i < LIMBS; i++) {
+            uint64_t sum = static_cast<uint64_t>(number[i]) + rhs.number[i] + carry;
+            number[i] = static_cast<uint32_t>(sum);
+            carry = sum >> ELEMENT_LENGTH;
+        }
+        if (BIGINT_CONSTANT_EVALUATED() && negative == rhs_negative && is_negative() != negative) {
+            fixed_integer_overflow();
+        }
+        return *this;
+    }
+
+    constexpr fixed_integer& operator-=(fixed_integer const& rhs) {
+        bool negative = is_negative();
+        bool rhs_negative = rhs.is_negative();
+        uint64_t borrow = 0;
+        for (size_t i = 0; i < LIMBS; i++) {
+            uint64_t diff = static_cast<uint64_t>(number[i]) - rhs.number[i] - borrow;
+            number[i] = static_cast<uint32_t>(diff);
+            borrow = diff >> 63u;
+        }
+        if (BIGINT_CONSTANT_EVALUATED() && negative != rhs_negative && is_negative() != negative) {
+            fixed_integer_overflow();
+        }
+        return *this;
+    }
+
+    constexpr fixed_integer& operator*=(fixed_integer const& rhs) {
+        if (BIGINT_CONSTANT_EVALUATED() && !product_fits(*this, rhs)) {
+            fixed_integer_overflow();
+        }
+        std::array<uint32_t, LIMBS> result = {};
+        for (size_t i = 0; i < LIMBS; i++) {
+            uint64_t carry = 0;
+            uint64_t x = number[i];
+            for (size_t j = 0; i + j < LIMBS; j++) {
+                uint64_t mul = result[i + j] + x * rhs.number[j] + carry;
+                result[i + j] = static_cast<uint32_t>(mul);
+                carry = mul >> ELEMENT_LENGTH;
+            }
+        }
+        number = result;
+        return *this;
+    }
+
+    constexpr fixed_integer& operator/=(fixed_integer const& rhs) {
+        bool negative = is_negative() != rhs.is_negative();
+        fixed_integer quotient, remainder;
+        divide(abs(*this), abs(rhs), quotient, remainder);
+        if (negative) {
+            quotient.negate();
+        } else if (BIGINT_CONSTANT_EVALUATED() && quotient.is_negative()) {
+            // The most negative value divided by -1.
+            fixed_integer_overflow();
+        }
+        return *this = quotient;
+    }
+
+    constexpr fixed_integer& operator%=(fixed_integer const& rhs) {
+        bool negative = is_negative();
+        fixed_integer quotient, remainder;
+        divide(abs(*this), abs(rhs), quotient, remainder);
+        if (negative) {
+            remainder.negate();
+        }
+        return *this = remainder;
+    }
+
+    constexpr fixed_integer& operator&=(fixed_integer const& rhs) {
+        for (size_t i = 0; i < LIMBS; i++) {
+            number[i] &= rhs.number[i];
+        }
+        return *this;
+    }
+
+    constexpr fixed_integer& operator|=(fixed_integer const& rhs) {
+        for (size_t i = 0; i < LIMBS; i++) {
+            number[i] |= rhs.number[i];
+        }
+        return *this;
+    }
+
+    constexpr fixed_integer& operator^=(fixed_integer const& rhs) {
+        for (size_t i = 0; i < LIMBS; i++) {
+            number[i] ^= rhs.number[i];
+        }
+        return *this;
+    }
+
+    constexpr fixed_integer& operator<<=(int rhs) {
+        size_t zeros = static_cast<size_t>(rhs) / ELEMENT_LENGTH;
+        size_t shift = static_cast<size_t>(rhs) % ELEMENT_LENGTH;
+        for (size_t i = LIMBS; i-- > 0;) {
+            uint64_t high = i >= zeros ? number[i - zeros] : 0;
+            uint64_t low = i >= zeros + 1 ? number[i - zeros - 1] : 0;
+            number[i] = static_cast<uint32_t>(((high << ELEMENT_LENGTH | low) << shift) >> ELEMENT_LENGTH);
+        }
+        return *this;
+    }
+
+    // Arithmetic shift: rounds towards negative infinity like big_integer.
+    constexpr fixed_integer& operator>>=(int rhs) {
+        uint32_t fill = is_negative() ? UINT32_MAX : 0;
+        size_t zeros = static_cast<size_t>(rhs) / ELEMENT_LENGTH;
+        size_t shift = static_cast<size_t>(rhs) % ELEMENT_LENGTH;
+        for (size_t i = 0; i < LIMBS; i++) {
+            uint64_t low = i + zeros < LIMBS ? number[i + zeros] : fill;
+            uint64_t high = i + zeros + 1 < LIMBS ? number[i + zeros + 1] : fill;
+            number[i] = static_cast<uint32_t>((high << ELEMENT_LENGTH | low) >> shift);
+        }
+        return *this;
+    }
+
+    constexpr fixed_integer operator+() const {
+        return *this;
+    }
+
+    constexpr fixed_integer operator-() const {
+        fixed_integer r(*this);
+        r.negate();
+        if (BIGINT_CONSTANT_EVALUATED() && is_negative() && r.is_negative()) {
+            fixed_integer_overflow();
+        }
+        return r;
+    }
+
+    constexpr fixed_integer operator~() const {
+        fixed_integer r(*this);
+        for (uint32_t& i : r.number) {
+            i = ~i;
+        }
+        return r;
+    }
+
+    constexpr fixed_integer& operator++() {
+        bool negative = is_negative();
+        add_small(1);
+        if (BIGINT_CONSTANT_EVALUATED() && !negative && is_negative()) {
+            fixed_integer_overflow();
+        }
+        return *this;
+    }
+
+    constexpr fixed_integer operator++(int) {
+        fixed_integer r = *this;
+        ++*this;
+        return r;
+    }
+
+    constexpr fixed_integer& operator--() {
+        return *this -= 1;
+    }
+
+    constexpr fixed_integer operator--(int) {
+        fixed_integer r = *this;
+        --*this;
+        return r;
+    }
+
+    friend constexpr fixed_integer operator+(fixed_integer a, fixed_integer const& b) {
+        return a += b;
+    }
+
+    friend constexpr fixed_integer operator-(fixed_integer a, fixed_integer const& b) {
+        return a -= b;
+    }
+
+    friend constexpr fixed_integer operator*(fixed_integer a, fixed_integer const& b) {
+        return a *= b;
+    }
+
+    friend constexpr fixed_integer operator/(fixed_integer a, fixed_integer const& b) {
+        return a /= b;
+    }
+
+    friend constexpr fixed_integer operator%(fixed_integer a, fixed_integer const& b) {
+        return a %= b;
+    }
+
+    friend constexpr fixed_integer operator&(fixed_integer a, fixed_integer const& b) {
+        return a &= b;
+    }
+
+    friend constexpr fixed_integer operator|(fixed_integer a, fixed_integer const& b) {
+        return a |= b;
+    }
+
+    friend constexpr fixed_integer operator^(fixed_integer a, fixed_integer const& b) {
+        return a ^= b;
+    }
+
+    friend constexpr fixed_integer operator<<(fixed_integer a, unsigned int b) {
+        return a <<= b;
+    }
+
+    friend constexpr fixed_integer operator>>(fixed_integer a, unsigned int b) {
+        return a >>= b;
+    }
+
+    friend constexpr int8_t compare(fixed_integer const& a, fixed_integer const& b) {
+        if (a.is_negative() != b.is_negative()) {
+            return a.is_negative() ? -1 : 1;
+        }
+        for (size_t i = LIMBS; i-- > 0;) {
+            if (a.number[i] != b.number[i]) {
+                return a.number[i] < b.number[i] ? -1 : 1;
+            }
+        }
+        return 0;
+    }
+
+    friend constexpr bool operator==(fixed_integer const& a, fixed_integer const& b) {
+        return compare(a, b) == 0;
+    }
+
+    friend constexpr bool operator!=(fixed_integer const& a, fixed_integer const& b) {
+        return compare(a, b) != 0;
+    }
+
+    friend constexpr bool operator<(fixed_integer const& a, fixed_integer const& b) {
+        return compare(a, b) < 0;
+    }
+
+    friend constexpr bool operator>(fixed_integer const& a, fixed_integer const& b) {
+        return compare(a, b) > 0;
+    }
+
+    friend constexpr bool operator<=(fixed_integer const& a, fixed_integer const& b) {
+        return compare(a, b) <= 0;
+    }
+
+    friend constexpr bool operator>=(fixed_integer const& a, fixed_integer const& b) {
+        return compare(a, b) >= 0;
+    }
+
+    friend std::string to_string(fixed_integer const& a) {
+        fixed_integer temp = abs(a);
+        std::string result;
+        do {
+            uint32_t chunk = temp.div_small(1000000000);
+            for (size_t i = 0; i < 9 && (chunk != 0 || !temp.is_zero()); i++) {
+                result += static_cast<char>('0' + chunk % 10);
+                chunk /= 10;
+            }
+        } while (!temp.is_zero());
+        if (result.empty()) {
+            result = "0";
+        }
+        if (a.is_negative()) {
+            result += '-';
+        }
+        return std::string(result.rbegin(), result.rend());
+    }
+
+    friend std::ostream& operator<<(std::ostream& s, fixed_integer const& a) {
+        return s << to_string(a);
+    }
+
+    constexpr bool is_negative() const {
+        return number[LIMBS - 1] >> (ELEMENT_LENGTH - 1);
+    }
+
+    // Little-endian two's complement limbs.
+    constexpr uint32_t const* data() const {
+        return number.data();
+    }
+
+private:
+    std::array<uint32_t, LIMBS> number;
+
+    constexpr bool is_zero() const {
+        for (uint32_t i : number) {
+            if (i != 0) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    constexpr void negate() {
+        for (uint32_t& i : number) {
+            i = ~i;
+        }
+        add_small(1);
+    }
+
+    static constexpr fixed_integer abs(fixed_integer a) {
+        if (a.is_negative()) {
+            a.negate();
+        }
+        return a;
+    }
+
+    constexpr void add_small(uint32_t value) {
+        uint64_t carry = value;
+        for (size_t i = 0; i < LIMBS && carry > 0; i++) {
+            uint64_t sum = number[i] + carry;
+            number[i] = static_cast<uint32_t>(sum);
+            carry = sum >> ELEMENT_LENGTH;
+        }
+    }
+
+    constexpr void mul_small(uint32_t value) {
+        uint64_t carry = 0;
+        for (size_t i = 0; i < LIMBS; i++) {
+            uint64_t mul = static_cast<uint64_t>(number[i]) * value + carry;
+            number[i] = static_cast<uint32_t>(mul);
+            carry = mul >> ELEMENT_LENGTH;
+        }
+    }
+
+    // Divides the value, taken as unsigned, in place and returns the remainder.
+    constexpr uint32_t div_small(uint32_t value) {
+        uint64_t carry = 0;
+        for (size_t i = LIMBS; i-- > 0;) {
+            uint64_t tmp = (carry << ELEMENT_LENGTH) + number[i];
+            number[i] = static_cast<uint32_t>(tmp / value);
+            carry = tmp % value;
+        }
+        return static_cast<uint32_t>(carry);
+    }
+
+    // Whether the product of a and b is representable, i.e. *= does not overflow.
+    static constexpr bool product_fits(fixed_integer const& a, fixed_integer const& b) {
+        fixed_integer x = abs(a);
+        fixed_integer y = abs(b);
+        std::array<uint32_t, 2 * LIMBS> full = {};
+        for (size_t i = 0; i < LIMBS; i++) {
+            uint64_t carry = 0;
+            for (size_t j = 0; j < LIMBS; j++) {
+                uint64_t mul = full[i + j] + static_cast<uint64_t>(x.number[i]) * y.number[j] + carry;
+                full[i + j] = static_cast<uint32_t>(mul);
+                carry = mul >> ELEMENT_LENGTH;
+            }
+            full[i + LIMBS] = static_cast<uint32_t>(carry);
+        }
+        for (size_t i = LIMBS; i < 2 * LIMBS; i++) {
+            if (full[i] != 0) {
+                return false;
+            }
+        }
+        if ((full[LIMBS - 1] >> (ELEMENT_LENGTH - 1)) == 0) {
+            return true;
+        }
+        // A magnitude of 2^(Bits - 1) fits only as the most negative value.
+        bool smallest = full[LIMBS - 1] == 1u << (ELEMENT_LENGTH - 1);
+        for (size_t i = 0; i + 1 < LIMBS; i++) {
+            smallest = smallest && full[i] == 0;
+        }
+        return smallest && a.is_negative() != b.is_negative();
+    }
+
+    constexpr size_t significant_limbs() const {
+        size_t n = LIMBS;
+        while (n > 0 && number[n - 1] == 0) {
+            n--;
+        }
+        return n;
+    }
+
+    // Unsigned long division (Knuth, TAOCP vol. 2, 4.3.1, algorithm D).
+    static constexpr void divide(fixed_integer const& u, fixed_integer const& v,
+                       fixed_integer& quotient, fixed_integer& remainder) {
+        quotient = fixed_integer();
+        remainder = fixed_integer();
+        size_t m = u.significant_limbs();
+        size_t n = v.significant_limbs();
+        if (n <= 1) {
+            quotient = u;
+            remainder.number[0] = quotient.div_small(v.number[0]);
+            return;
+        }
+        if (m < n) {
+            remainder = u;
+            return;
+        }
+        uint32_t shift = ELEMENT_LENGTH - 1;
+        while (v.number[n - 1] >> shift == 0) {
+            shift--;
+        }
+        shift = ELEMENT_LENGTH - 1 - shift;
+        std::array<uint32_t, LIMBS> vn = {};
+        std::array<uint32_t, LIMBS + 1> un = {};
+        for (size_t i = 0; i < n; i++) {
+            uint64_t low = i > 0 ? v.number[i - 1] : 0;
+            vn[i] = static_cast<uint32_t>((static_cast<uint64_t>(v.number[i]) << shift) |
+                                          (low >> (ELEMENT_LENGTH - shift)));
+        }
+        for (size_t i = 0; i <= m; i++) {
+            uint64_t high = i < m ? u.number[i] : 0;
+            uint64_t low = i > 0 ? u.number[i - 1] : 0;
+            un[i] = static_cast<uint32_t>((high << shift) | (low >> (ELEMENT_LENGTH - shift)));
+        }
+        const uint64_t base = static_cast<uint64_t>(1) << ELEMENT_LENGTH;
+        for (size_t j = m - n + 1; j-- > 0;) {
+            uint64_t top = (static_cast<uint64_t>(un[j + n]) << ELEMENT_LENGTH) | un[j + n - 1];
+            uint64_t qhat = top / vn[n - 1];
+            uint64_t rhat = top % vn[n - 1];
+            while (qhat >= base || qhat * vn[n - 2] > ((rhat << ELEMENT_LENGTH) | un[j + n - 2])) {
+                qhat--;
+                rhat += vn[n - 1];
+                if (rhat >= base) {
+                    break;
+                }
+            }
+            uint64_t carry = 0;
+            uint64_t borrow = 0;
+            for (size_t i = 0; i < n; i++) {
+                uint64_t mul = qhat * vn[i] + carry;
+                carry = mul >> ELEMENT_LENGTH;
+                uint64_t diff = static_cast<uint64_t>(un[i + j]) - static_cast<uint32_t>(mul) - borrow;
+                un[i + j] = static_cast<uint32_t>(diff);
+                borrow = diff >> 63u;
+            }
+            uint64_t diff = static_cast<uint64_t>(un[j + n]) - carry - borrow;
+            un[j + n] = static_cast<uint32_t>(diff);
+            if (diff >> 63u) {
+                qhat--;
+                carry = 0;
+                for (size_t i = 0; i < n; i++) {
+                    uint64_t sum = static_cast<uint64_t>(un[i + j]) + vn[i] + carry;
+                    un[i + j] = static_cast<uint32_t>(sum);
+                    carry = sum >> ELEMENT_LENGTH;
+                }
+                un[j + n] += static_cast<uint32_t>(carry);
+            }
+            quotient.number[j] = static_cast<uint32_t>(qhat);
+        }
+        for (size_t i = 0; i < n; i++) {
+            remainder.number[i] = static_cast<uint32_t>((un[i] >> shift) |
+                                                        (static_cast<uint64_t>(un[i + 1]) << (ELEMENT_LENGTH - shift)));
+        }
+    }
+};
+
+// Width of the narrowest fixed_integer able to hold any decimal literal of the given length:
+// log2(10) < 3.322 bits per digit plus the sign bit, rounded up to whole limbs.
+constexpr size_t fixed_integer_literal_bits(size_t digits) {
+    return ((digits * 3322 + 999) / 1000 + 1 + 31) / 32 * 32;
+}
+
+// 170141183460469231731687303715884105727_bi is parsed by the compiler; assigning it to a
+// big_integer copies the limbs without touching the string constructor. Each literal gets
+// the narrowest width, so widen operands explicitly to keep mixed arithmetic constexpr and
+// to make room for results: in a constant expression 1000000_bi * 1000000_bi overflows 32 bits
+// and does not compile, while fixed_integer<64>(1000000_bi) * fixed_integer<64>(1000000_bi) does.
+template<char... Digits>
+constexpr fixed_integer<fixed_integer_literal_bits(sizeof...(Digits))> operator""_bi() {
+    static_assert(((('0' <= Digits && Digits <= '9') || Digits == '\'') && ...),
+                  "_bi literals must be decimal integers");
+    constexpr char digits[] = {Digits...};
+    return fixed_integer<fixed_integer_literal_bits(sizeof...(Digits))>(std::string_view(digits, sizeof...(Digits)));
+}
+
+#endif //BIGINT_FIXED_INTEGER_H
@@ -0,0 +1,159 @@
+#include "instrumentation.h"
+
+#include <atomic>
+#include <chrono>
+#include <ostream>
+#include <sstream>
+
+namespace {
+// Relaxed atomics: counts from concurrent threads must not be lost, but need no ordering.
+struct counters {
+    std::atomic<uint64_t> calls;
+    std::atomic<uint64_t> limbs;
+    std::atomic<uint64_t> allocations;
+    std::atomic<uint64_t> cow_copies;
+    std::atomic<uint64_t> nanoseconds;
+    std::atomic<uint64_t> latency[instrumentation::SIZE_BUCKETS][instrumentation::LATENCY_BUCKETS];
+};
+
+// Zero-initialized as a static.
+counters table[instrumentation::OPS];
+
+thread_local bool inside = false;
+thread_local instrumentation::op current = instrumentation::op::other;
+
+char const* const NAMES[instrumentation::OPS] = {
+        "add", "sub", "mul", "div", "mod", "and", "or", "xor", "shl", "shr", "neg", "compare",
+        "to_string", "from_string", "other",
+};
+
+counters& of(instrumentation::op operation) {
+    return table[static_cast<size_t>(operation)];
+}
+
+void bump(std::atomic<uint64_t>& counter, uint64_t value) {
+    counter.fetch_add(value, std::memory_order_relaxed);
+}
+
+size_t bucket(uint64_t value, size_t buckets) {
+    size_t k = 0;
+    while (value > 0 && k + 1 < buckets) {
+        value >>= 1;
+        k++;
+    }
+    return k;
+}
+
+int64_t now() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+uint64_t upper_bound(size_t k) {
+    return static_cast<uint64_t>(1) << k;
+}
+}
+
+instrumentation::scope::scope(op operation, size_t limbs) noexcept
+        : outermost(!inside), operation(operation), limbs(limbs), start(0) {
+    if (outermost) {
+        inside = true;
+        current = operation;
+        start = now();
+    }
+}
+
+instrumentation::scope::~scope() {
+    if (!outermost) {
+        return;
+    }
+    uint64_t elapsed = static_cast<uint64_t>(now() - start);
+    counters& c = of(operation);
+    bump(c.calls, 1);
+    bump(c.limbs, limbs);
+    bump(c.nanoseconds, elapsed);
+    bump(c.latency[bucket(limbs, SIZE_BUCKETS)][bucket(elapsed, LATENCY_BUCKETS)], 1);
+    inside = false;
+    current = op::other;
+}
+
+void instrumentation::count_allocation() noexcept {
+    bump(of(current).allocations, 1);
+}
+
+void instrumentation::count_cow_copy() noexcept {
+    bump(of(current).cow_copies, 1);
+}
+
+bool instrumentation::enabled() {
+#ifdef BIGINT_INSTRUMENTATION
+    return true;
+#else
+    return false;
+#endif
+}
+
+char const* instrumentation::name(op operation) {
+    return NAMES[static_cast<size_t>(operation)];
+}
+
+instrumentation::stats instrumentation::snapshot(op operation) {
+    counters const& c = of(operation);
+    stats result{};
+    result.calls = c.calls.load(std::memory_order_relaxed);
+    result.limbs = c.limbs.load(std::memory_order_relaxed);
+    result.allocations = c.allocations.load(std::memory_order_relaxed);
+    result.cow_copies = c.cow_copies.load(std::memory_order_relaxed);
+    result.nanoseconds = c.nanoseconds.load(std::memory_order_relaxed);
+    for (size_t i = 0; i < SIZE_BUCKETS; i++) {
+        for (size_t j = 0; j < LATENCY_BUCKETS; j++) {
+            result.latency[i][j] = c.latency[i][j].load(std::memory_order_relaxed);
+        }
+    }
+    return result;
+}
+
+void instrumentation::reset() {
+    for (counters& c : table) {
+        c.calls.store(0, std::memory_order_relaxed);
+        c.limbs.store(0, std::memory_order_relaxed);
+        c.allocations.store(0, std::memory_order_relaxed);
+        c.cow_copies.store(0, std::memory_order_relaxed);
+        c.nanoseconds.store(0, std::memory_order_relaxed);
+        for (auto& row : c.latency) {
+            for (auto& cell : row) {
+                cell.store(0, std::memory_order_relaxed);
+            }
+        }
+    }
+}
+
+std::string instrumentation::to_json() {
+    std::ostringstream out;
+    out << "{\"enabled\": " << (enabled() ? "true" : "false") << ", \"operators\": [";
+    for (size_t k = 0; k < OPS; k++) {
+        op operation = static_cast<op>(k);
+        stats s = snapshot(operation);
+        out << (k == 0 ? "" : ", ") << "\n  {\"name\": \"" << name(operation) << "\", \"calls\": " << s.calls
+            << ", \"limbs\": " << s.limbs << ", \"allocations\": " << s.allocations
+            << ", \"cow_copies\": " << s.cow_copies << ", \"ns\": " << s.nanoseconds << ", \"latency\": [";
+        bool first = true;
+        for (size_t i = 0; i < SIZE_BUCKETS; i++) {
+            for (size_t j = 0; j < LATENCY_BUCKETS; j++) {
+                if (s.latency[i][j] == 0) {
+                    continue;
+                }
+                out << (first ? "" : ", ") << "{\"limbs_below\": " << upper_bound(i) << ", \"ns_below\": "
+                    << upper_bound(j) << ", \"count\": " << s.latency[i][j] << "}";
+                first = false;
+            }
+        }
+        out << "]}";
+    }
+    out << "\n]}\n";
+    return out.str();
+}
+
+void instrumentation::dump(std::ostream& out) {
+    out << to_json();
+}
@@ -0,0 +1,85 @@
+#ifndef BIGINT_INSTRUMENTATION_H
+#define BIGINT_INSTRUMENTATION_H
+
+#include <cstddef>
+#include <cstdint>
+#include <iosfwd>
+#include <string>
+
+// Per-operator counters of big_integer: calls, limbs of the operands, allocations, copy-on-write
+// copies (where numbers share limbs), time and latency histograms by operand size. The hooks
+// are compiled in only with BIGINT_INSTRUMENTATION defined (the CMake option of the same name);
+// otherwise the counters stay zero. An operator called from another one on the same thread is
+// accounted to the outer one, as are allocations made meanwhile; allocations outside operators,
+// including those of helper threads, go to op::other.
+namespace instrumentation {
+enum class op {
+    add, sub, mul, div, mod, bit_and, bit_or, bit_xor, shl, shr, neg, compare, to_string, from_string, other,
+};
+
+const size_t OPS = static_cast<size_t>(op::other) + 1;
+
+// Bucket k of both histogram axes holds values in [2^(k - 1), 2^k), bucket 0 holds zero;
+// the last bucket takes everything above.
+const size_t SIZE_BUCKETS = 24;
+const size_t LATENCY_BUCKETS = 40;
+
+struct stats {
+    uint64_t calls;
+    uint64_t limbs;
+    uint64_t allocations;
+    uint64_t cow_copies;
+    uint64_t nanoseconds;
+    // latency[size bucket of limbs][latency bucket of nanoseconds]
+    uint64_t latency[SIZE_BUCKETS][LATENCY_BUCKETS];
+};
+
+// Times one operator call on limbs limbs, from construction to destruction.
+struct scope {
+    scope(op operation, size_t limbs) noexcept;
+
+    scope(scope const& other) = delete;
+
+    scope& operator=(scope const& other) = delete;
+
+    ~scope();
+
+private:
+    bool outermost;
+    op operation;
+    size_t limbs;
+    int64_t start;
+};
+
+void count_allocation() noexcept;
+
+void count_cow_copy() noexcept;
+
+// Whether this build has the hooks compiled in.
+bool enabled();
+
+char const* name(op operation);
+
+stats snapshot(op operation);
+
+void reset();
+
+// {"enabled": ..., "operators": [{"name": ..., "calls": ..., ..., "latency": [...]}, ...]}, where
+// latency lists non-empty buckets as {"limbs_below": ..., "ns_below": ..., "count": ...}.
+std::string to_json();
+
+void dump(std::ostream& out);
+}
+
+#ifdef BIGINT_INSTRUMENTATION
+#define BIGINT_INSTRUMENT(operation, limbs) \
+    instrumentation::scope instrumented_scope(instrumentation::op::operation, (limbs))
+#define BIGINT_COUNT_ALLOCATION() instrumentation::count_allocation()
+#define BIGINT_COUNT_COW_COPY() instrumentation::count_cow_copy()
+#else
+#define BIGINT_INSTRUMENT(operation, limbs) static_cast<void>(0)
+#define BIGINT_COUNT_ALLOCATION() static_cast<void>(0)
+#define BIGINT_COUNT_COW_COPY() static_cast<void>(0)
+#endif
+
+#endif //BIGINT_INSTRUMENTATION_H
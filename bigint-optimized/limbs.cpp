@@ -0,0 +1,541 @@
+#include "limbs.h"
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "arena.h"
+
+#ifdef BIGINT_X86_64_ASM
+// limbs_x86_64.S
+extern "C" {
+uint32_t limbs_add_n_x86_64(uint32_t* r, uint32_t const* a, uint32_t const* b, size_t n);
+
+uint32_t limbs_sub_n_x86_64(uint32_t* r, uint32_t const* a, uint32_t const* b, size_t n);
+
+uint32_t limbs_addmul_1_x86_64(uint32_t* r, uint32_t const* a, size_t n, uint32_t b);
+
+uint32_t limbs_addmul_1_adx(uint32_t* r, uint32_t const* a, size_t n, uint32_t b);
+}
+
+#include <cpuid.h>
+#endif
+
+namespace {
+const unsigned LIMB_BITS = 32;
+const uint64_t BASE = static_cast<uint64_t>(1) << LIMB_BITS;
+
+uint32_t low(uint64_t a) {
+    return static_cast<uint32_t>(a);
+}
+
+uint32_t high(uint64_t a) {
+    return static_cast<uint32_t>(a >> LIMB_BITS);
+}
+
+// wyhash's constants and its mixing step: the 128-bit product of two words, halves xored.
+const uint64_t HASH_SECRET[] = {0xa0761d6478bd642full, 0xe7037ed1a0b428dbull, 0x8ebc6af09c88c6e3ull};
+
+uint64_t hash_mix(uint64_t a, uint64_t b) {
+#ifdef __SIZEOF_INT128__
+    __extension__ typedef unsigned __int128 uint128_t;
+    uint128_t product = static_cast<uint128_t>(a) * b;
+    return static_cast<uint64_t>(product) ^ static_cast<uint64_t>(product >> 64);
+#else
+    uint64_t ll = static_cast<uint64_t>(low(a)) * low(b);
+    uint64_t lh = static_cast<uint64_t>(low(a)) * high(b);
+    uint64_t hl = static_cast<uint64_t>(high(a)) * low(b);
+    uint64_t hh = static_cast<uint64_t>(high(a)) * high(b);
+    uint64_t middle = (ll >> LIMB_BITS) + low(lh) + low(hl);
+    uint64_t product_low = (middle << LIMB_BITS) | low(ll);
+    uint64_t product_high = hh + (lh >> LIMB_BITS) + (hl >> LIMB_BITS) + (middle >> LIMB_BITS);
+    return product_low ^ product_high;
+#endif
+}
+
+// Limbs i and i + 1 of a[0, n) as one word, zero past the end.
+uint64_t hash_word(uint32_t const* a, size_t n, size_t i) {
+    return (i < n ? a[i] : 0) | (i + 1 < n ? static_cast<uint64_t>(a[i + 1]) << LIMB_BITS : 0);
+}
+
+uint32_t add_n_generic(uint32_t* r, uint32_t const* a, uint32_t const* b, size_t n) {
+    uint64_t carry = 0;
+    for (size_t i = 0; i < n; i++) {
+        uint64_t sum = static_cast<uint64_t>(a[i]) + b[i] + carry;
+        r[i] = low(sum);
+        carry = high(sum);
+    }
+    return static_cast<uint32_t>(carry);
+}
+
+uint32_t sub_n_generic(uint32_t* r, uint32_t const* a, uint32_t const* b, size_t n) {
+    uint64_t borrow = 0;
+    for (size_t i = 0; i < n; i++) {
+        uint64_t diff = static_cast<uint64_t>(a[i]) - b[i] - borrow;
+        r[i] = low(diff);
+        borrow = diff >> 63u;
+    }
+    return static_cast<uint32_t>(borrow);
+}
+
+uint32_t addmul_1_generic(uint32_t* r, uint32_t const* a, size_t n, uint32_t b) {
+    uint64_t carry = 0;
+    for (size_t i = 0; i < n; i++) {
+        // (2^32 - 1)^2 + 2 * (2^32 - 1) still fits in 64 bits.
+        uint64_t product = static_cast<uint64_t>(a[i]) * b + r[i] + carry;
+        r[i] = low(product);
+        carry = high(product);
+    }
+    return static_cast<uint32_t>(carry);
+}
+
+struct kernel_table {
+    uint32_t (*add_n)(uint32_t* r, uint32_t const* a, uint32_t const* b, size_t n);
+    uint32_t (*sub_n)(uint32_t* r, uint32_t const* a, uint32_t const* b, size_t n);
+    uint32_t (*addmul_1)(uint32_t* r, uint32_t const* a, size_t n, uint32_t b);
+};
+
+constexpr kernel_table GENERIC = {add_n_generic, sub_n_generic, addmul_1_generic};
+#ifdef BIGINT_X86_64_ASM
+constexpr kernel_table X86_64 = {limbs_add_n_x86_64, limbs_sub_n_x86_64, limbs_addmul_1_x86_64};
+constexpr kernel_table ADX = {limbs_add_n_x86_64, limbs_sub_n_x86_64, limbs_addmul_1_adx};
+#endif
+
+// Constant-initialized, so arithmetic in other static initializers runs on the generic set
+// until detection below has happened.
+kernel_table active = GENERIC;
+limbs::kernel_set active_set = limbs::kernel_set::generic;
+
+#ifdef BIGINT_X86_64_ASM
+bool cpu_has_adx() {
+    unsigned eax, ebx, ecx, edx;
+    return __get_cpuid_count(7, 0, &eax, &ebx, &ecx, &edx) && (ebx & bit_BMI2) && (ebx & bit_ADX);
+}
+#endif
+
+limbs::kernel_set best_kernels() {
+    if (limbs::kernels_supported(limbs::kernel_set::adx)) {
+        return limbs::kernel_set::adx;
+    } else if (limbs::kernels_supported(limbs::kernel_set::x86_64)) {
+        return limbs::kernel_set::x86_64;
+    }
+    return limbs::kernel_set::generic;
+}
+
+bool const detected = limbs::use_kernels(best_kernels());
+
+std::atomic<unsigned> threads_for_mul(1);
+
+// Worker threads for the parallel half products. Workers are started for the largest degree of
+// parallelism asked for and kept until exit. A thread that waits for a product it handed out runs
+// queued ones meanwhile, so nested splits never starve the pool.
+class mul_pool {
+public:
+    struct job {
+        std::function<void()> work;
+        bool done = false;
+        std::exception_ptr error;
+        mul_pool* owner = nullptr;
+
+        // A submitted job writes to the buffers of its caller, so unwinding still waits for it.
+        ~job() {
+            if (owner != nullptr) {
+                owner->settle(*this);
+            }
+        }
+    };
+
+    ~mul_pool() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        wake.notify_all();
+        for (std::thread& worker : workers) {
+            worker.join();
+        }
+    }
+
+    void reserve(size_t count) {
+        std::lock_guard<std::mutex> lock(mutex);
+        while (workers.size() < count) {
+            workers.emplace_back(&mul_pool::serve, this);
+        }
+    }
+
+    void submit(job& next) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            next.owner = this;
+            queue.push_back(&next);
+        }
+        wake.notify_all();
+    }
+
+    // Waits for a submitted job and rethrows what it threw.
+    void wait(job& submitted) {
+        settle(submitted);
+        if (submitted.error) {
+            std::rethrow_exception(submitted.error);
+        }
+    }
+
+private:
+    void settle(job& submitted) {
+        std::unique_lock<std::mutex> lock(mutex);
+        while (!submitted.done) {
+            if (queue.empty()) {
+                wake.wait(lock);
+            } else {
+                run_front(lock);
+            }
+        }
+        submitted.owner = nullptr;
+    }
+
+    void serve() {
+        std::unique_lock<std::mutex> lock(mutex);
+        for (;;) {
+            if (!queue.empty()) {
+                run_front(lock);
+            } else if (stopping) {
+                return;
+            } else {
+                wake.wait(lock);
+            }
+        }
+    }
+
+    // Runs the oldest queued job with the lock released.
+    void run_front(std::unique_lock<std::mutex>& lock) {
+        job* next = queue.front();
+        queue.pop_front();
+        lock.unlock();
+        try {
+            next->work();
+        } catch (...) {
+            next->error = std::current_exception();
+        }
+        lock.lock();
+        next->done = true;
+        wake.notify_all();
+    }
+
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::deque<job*> queue;
+    std::vector<std::thread> workers;
+    bool stopping = false;
+};
+
+mul_pool& pool() {
+    static mul_pool instance;
+    return instance;
+}
+
+void multiply(uint32_t* r, uint32_t const* a, size_t n, uint32_t const* b, size_t m, unsigned threads);
+
+// For n >= 2m: a is cut into pieces of m limbs, each piece product overlaps the previous one in m limbs.
+void multiply_sliced(uint32_t* r, uint32_t const* a, size_t n, uint32_t const* b, size_t m, unsigned threads) {
+    multiply(r, a, m, b, m, threads);
+    scratch_limbs piece = scratch(2 * m);
+    for (size_t offset = m; offset < n; offset += m) {
+        size_t length = std::min(m, n - offset);
+        multiply(piece.data(), a + offset, length, b, m, threads);
+        uint32_t carry = limbs::add_n(r + offset, r + offset, piece.data(), m);
+        limbs::add_1(r + offset + m, piece.data() + m, length, carry);
+    }
+}
+
+// With a = a1 B^h + a0 and b = b1 B^h + b0, where B = 2^32 and h is half of n:
+// a * b = z2 B^2h + ((a0 + a1)(b0 + b1) - z2 - z0) B^h + z0, with z2 = a1 b1 and z0 = a0 b0.
+// Needs m > h, so that b1 is not empty.
+void karatsuba(uint32_t* r, uint32_t const* a, size_t n, uint32_t const* b, size_t m, unsigned threads) {
+    size_t h = (n + 1) / 2;
+    scratch_limbs sums = scratch(2 * h + 2);
+    uint32_t* sa = sums.data();
+    uint32_t* sb = sa + h + 1;
+    sa[h] = limbs::add_1(sa + n - h, a + n - h, 2 * h - n, limbs::add_n(sa, a, a + h, n - h));
+    sb[h] = limbs::add_1(sb + m - h, b + m - h, 2 * h - m, limbs::add_n(sb, b, b + h, m - h));
+    scratch_limbs middle = scratch(2 * h + 2);
+
+    // z0 goes to r[0, 2h) and z2 to r[2h, n + m), the middle product to its own buffer.
+    unsigned spawned = threads > 1 && m >= limbs::PARALLEL_MUL_LIMBS ? std::min(threads - 1, 2u) : 0;
+    unsigned share = threads / (spawned + 1);
+    mul_pool::job high;
+    mul_pool::job low;
+    if (spawned > 0) {
+        pool().reserve(threads - 1);
+        high.work = [=] { multiply(r + 2 * h, a + h, n - h, b + h, m - h, share); };
+        pool().submit(high);
+    } else {
+        multiply(r + 2 * h, a + h, n - h, b + h, m - h, share);
+    }
+    if (spawned > 1) {
+        low.work = [=] { multiply(r, a, h, b, h, share); };
+        pool().submit(low);
+    } else {
+        multiply(r, a, h, b, h, share);
+    }
+    multiply(middle.data(), sa, h + 1, sb, h + 1, threads - spawned * share);
+    if (spawned > 0) {
+        pool().wait(high);
+    }
+    if (spawned > 1) {
+        pool().wait(low);
+    }
+
+    size_t high_size = n + m - 2 * h;
+    uint32_t borrow = limbs::sub_n(middle.data(), middle.data(), r, 2 * h);
+    limbs::sub_1(middle.data() + 2 * h, middle.data() + 2 * h, 2, borrow);
+    borrow = limbs::sub_n(middle.data(), middle.data(), r + 2 * h, high_size);
+    limbs::sub_1(middle.data() + high_size, middle.data() + high_size, 2 * h + 2 - high_size, borrow);
+    // The middle term fits below B^(n + m - h); its buffer may have two more (zero) limbs.
+    size_t size = std::min(2 * h + 2, n + m - h);
+    uint32_t carry = limbs::add_n(r + h, r + h, middle.data(), size);
+    limbs::add_1(r + h + size, r + h + size, n + m - h - size, carry);
+}
+
+void multiply(uint32_t* r, uint32_t const* a, size_t n, uint32_t const* b, size_t m, unsigned threads) {
+    if (n < m) {
+        std::swap(a, b);
+        std::swap(n, m);
+    }
+    if (limbs::ifma_enabled() && m >= limbs::RADIX52_MIN_LIMBS && n <= limbs::RADIX52_MAX_LIMBS) {
+        limbs::mul_radix52(r, a, n, b, m, true);
+    } else if (m < limbs::KARATSUBA_LIMBS) {
+        limbs::mul_basecase(r, a, n, b, m);
+    } else if (2 * m <= n + 1) {
+        multiply_sliced(r, a, n, b, m, threads);
+    } else {
+        karatsuba(r, a, n, b, m, threads);
+    }
+}
+}
+
+uint32_t limbs::add_n(uint32_t* r, uint32_t const* a, uint32_t const* b, size_t n) {
+    return active.add_n(r, a, b, n);
+}
+
+uint32_t limbs::add_1(uint32_t* r, uint32_t const* a, size_t n, uint32_t b) {
+    uint64_t carry = b;
+    size_t i = 0;
+    for (; i < n && carry > 0; i++) {
+        uint64_t sum = a[i] + carry;
+        r[i] = low(sum);
+        carry = high(sum);
+    }
+    if (r != a) {
+        for (; i < n; i++) {
+            r[i] = a[i];
+        }
+    }
+    return static_cast<uint32_t>(carry);
+}
+
+uint32_t limbs::sub_n(uint32_t* r, uint32_t const* a, uint32_t const* b, size_t n) {
+    return active.sub_n(r, a, b, n);
+}
+
+uint32_t limbs::sub_1(uint32_t* r, uint32_t const* a, size_t n, uint32_t b) {
+    uint64_t borrow = b;
+    size_t i = 0;
+    for (; i < n && borrow > 0; i++) {
+        uint64_t diff = a[i] - borrow;
+        r[i] = low(diff);
+        borrow = diff >> 63u;
+    }
+    if (r != a) {
+        for (; i < n; i++) {
+            r[i] = a[i];
+        }
+    }
+    return static_cast<uint32_t>(borrow);
+}
+
+uint32_t limbs::mul_1(uint32_t* r, uint32_t const* a, size_t n, uint32_t b) {
+    uint64_t carry = 0;
+    for (size_t i = 0; i < n; i++) {
+        uint64_t product = static_cast<uint64_t>(a[i]) * b + carry;
+        r[i] = low(product);
+        carry = high(product);
+    }
+    return static_cast<uint32_t>(carry);
+}
+
+uint32_t limbs::addmul_1(uint32_t* r, uint32_t const* a, size_t n, uint32_t b) {
+    return active.addmul_1(r, a, n, b);
+}
+
+uint32_t limbs::submul_1(uint32_t* r, uint32_t const* a, size_t n, uint32_t b) {
+    uint64_t carry = 0;
+    for (size_t i = 0; i < n; i++) {
+        uint64_t product = static_cast<uint64_t>(a[i]) * b + carry;
+        uint32_t subtrahend = low(product);
+        carry = high(product) + (r[i] < subtrahend);
+        r[i] -= subtrahend;
+    }
+    return static_cast<uint32_t>(carry);
+}
+
+void limbs::mul(uint32_t* r, uint32_t const* a, size_t n, uint32_t const* b, size_t m) {
+    multiply(r, a, n, b, m, threads_for_mul.load(std::memory_order_relaxed));
+}
+
+void limbs::mul(uint32_t* r, uint32_t const* a, size_t n, uint32_t const* b, size_t m, unsigned threads) {
+    multiply(r, a, n, b, m, std::max(threads, 1u));
+}
+
+void limbs::mul_basecase(uint32_t* r, uint32_t const* a, size_t n, uint32_t const* b, size_t m) {
+    r[n] = mul_1(r, a, n, b[0]);
+    for (size_t i = 1; i < m; i++) {
+        r[i + n] = addmul_1(r + i, a, n, b[i]);
+    }
+}
+
+void limbs::set_mul_threads(unsigned threads) {
+    threads_for_mul.store(std::max(threads, 1u), std::memory_order_relaxed);
+    if (threads > 1) {
+        pool().reserve(threads - 1);
+    }
+}
+
+unsigned limbs::mul_threads() {
+    return threads_for_mul.load(std::memory_order_relaxed);
+}
+
+uint32_t limbs::divrem_1(uint32_t* q, uint32_t const* a, size_t n, uint32_t b) {
+    uint64_t remainder = 0;
+    for (size_t i = n; i-- > 0;) {
+        uint64_t current = (remainder << LIMB_BITS) | a[i];
+        q[i] = low(current / b);
+        remainder = current % b;
+    }
+    return static_cast<uint32_t>(remainder);
+}
+
+void limbs::divrem(uint32_t* q, uint32_t* u, size_t size, uint32_t const* v, size_t n) {
+    for (size_t j = size - n; j-- > 0;) {
+        uint64_t top = (static_cast<uint64_t>(u[j + n]) << LIMB_BITS) | u[j + n - 1];
+        uint64_t qhat = top / v[n - 1];
+        uint64_t rhat = top % v[n - 1];
+        while (qhat >= BASE || qhat * v[n - 2] > ((rhat << LIMB_BITS) | u[j + n - 2])) {
+            qhat--;
+            rhat += v[n - 1];
+            if (rhat >= BASE) {
+                break;
+            }
+        }
+        uint32_t borrow = submul_1(u + j, v, n, low(qhat));
+        uint32_t current = u[j + n];
+        u[j + n] = current - borrow;
+        if (current < borrow) {
+            qhat--;
+            u[j + n] += add_n(u + j, u + j, v, n);
+        }
+        q[j] = low(qhat);
+    }
+}
+
+uint32_t limbs::lshift(uint32_t* r, uint32_t const* a, size_t n, unsigned shift) {
+    if (n == 0) {
+        return 0;
+    }
+    uint32_t result = high(static_cast<uint64_t>(a[n - 1]) << shift);
+    for (size_t i = n - 1; i > 0; i--) {
+        r[i] = low(static_cast<uint64_t>(a[i]) << shift) | high(static_cast<uint64_t>(a[i - 1]) << shift);
+    }
+    r[0] = low(static_cast<uint64_t>(a[0]) << shift);
+    return result;
+}
+
+uint32_t limbs::rshift(uint32_t* r, uint32_t const* a, size_t n, unsigned shift) {
+    if (n == 0) {
+        return 0;
+    }
+    uint32_t result = low(static_cast<uint64_t>(a[0]) << (LIMB_BITS - shift));
+    for (size_t i = 0; i + 1 < n; i++) {
+        r[i] = low(((static_cast<uint64_t>(a[i + 1]) << LIMB_BITS) | a[i]) >> shift);
+    }
+    r[n - 1] = a[n - 1] >> shift;
+    return result;
+}
+
+int limbs::cmp(uint32_t const* a, uint32_t const* b, size_t n) {
+    for (size_t i = n; i-- > 0;) {
+        if (a[i] != b[i]) {
+            return a[i] < b[i] ? -1 : 1;
+        }
+    }
+    return 0;
+}
+
+uint64_t limbs::hash(uint32_t const* a, size_t n, uint64_t seed) {
+    seed = hash_mix(seed ^ HASH_SECRET[0], n ^ HASH_SECRET[1]);
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        uint64_t x = a[i] | static_cast<uint64_t>(a[i + 1]) << LIMB_BITS;
+        uint64_t y = a[i + 2] | static_cast<uint64_t>(a[i + 3]) << LIMB_BITS;
+        seed = hash_mix(x ^ HASH_SECRET[1], y ^ seed);
+    }
+    if (i < n) {
+        seed = hash_mix(hash_word(a, n, i) ^ HASH_SECRET[1], hash_word(a, n, i + 2) ^ seed);
+    }
+    return hash_mix(seed ^ HASH_SECRET[2], n ^ HASH_SECRET[1]);
+}
+
+limbs::kernel_set limbs::active_kernels() {
+    return active_set;
+}
+
+char const* limbs::kernel_set_name(kernel_set set) {
+    switch (set) {
+        case kernel_set::x86_64:
+            return "x86_64";
+        case kernel_set::adx:
+            return "adx";
+        default:
+            return "generic";
+    }
+}
+
+bool limbs::kernels_supported(kernel_set set) {
+    switch (set) {
+        case kernel_set::generic:
+            return true;
+#ifdef BIGINT_X86_64_ASM
+        case kernel_set::x86_64:
+            return true;
+        case kernel_set::adx:
+            return cpu_has_adx();
+#endif
+        default:
+            return false;
+    }
+}
+
+bool limbs::use_kernels(kernel_set set) {
+    if (!kernels_supported(set)) {
+        return false;
+    }
+    switch (set) {
+#ifdef BIGINT_X86_64_ASM
+        case kernel_set::x86_64:
+            active = X86_64;
+            break;
+        case kernel_set::adx:
+            active = ADX;
+            break;
+#endif
+        default:
+            active = GENERIC;
+    }
+    active_set = set;
+    return true;
+}
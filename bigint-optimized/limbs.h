@@ -0,0 +1,127 @@
+#ifndef BIGINT_LIMBS_H
+#define BIGINT_LIMBS_H
+
+#include <cstddef>
+#include <cstdint>
+
+// Unsigned arithmetic on little-endian arrays of 32-bit limbs, in the manner of GMP's mpn layer.
+// Sizes are in limbs and may be zero unless stated otherwise. A result may coincide with an
+// operand where noted, but must never partially overlap one.
+namespace limbs {
+// r = a + b, returns the carry. r may be a or b.
+uint32_t add_n(uint32_t* r, uint32_t const* a, uint32_t const* b, size_t n);
+
+// r = a + b, returns the carry. r may be a.
+uint32_t add_1(uint32_t* r, uint32_t const* a, size_t n, uint32_t b);
+
+// r = a - b, returns the borrow. r may be a or b.
+uint32_t sub_n(uint32_t* r, uint32_t const* a, uint32_t const* b, size_t n);
+
+// r = a - b, returns the borrow. r may be a.
+uint32_t sub_1(uint32_t* r, uint32_t const* a, size_t n, uint32_t b);
+
+// r = a * b, returns the high limb. r may be a.
+uint32_t mul_1(uint32_t* r, uint32_t const* a, size_t n, uint32_t b);
+
+// r += a * b, returns the high limb.
+uint32_t addmul_1(uint32_t* r, uint32_t const* a, size_t n, uint32_t b);
+
+// r -= a * b, returns the limb to be borrowed from r[n].
+uint32_t submul_1(uint32_t* r, uint32_t const* a, size_t n, uint32_t b);
+
+// r[0, n + m) = a * b with n, m > 0. r must not overlap a or b. Picks schoolbook, radix 2^52
+// or Karatsuba by size and runs on up to mul_threads() threads for huge operands.
+void mul(uint32_t* r, uint32_t const* a, size_t n, uint32_t const* b, size_t m);
+
+// The same with an explicit degree of parallelism instead of mul_threads().
+void mul(uint32_t* r, uint32_t const* a, size_t n, uint32_t const* b, size_t m, unsigned threads);
+
+// Schoolbook product, the base case of mul; rows run over a, so n >= m is faster.
+void mul_basecase(uint32_t* r, uint32_t const* a, size_t n, uint32_t const* b, size_t m);
+
+// Operands of at least KARATSUBA_LIMBS limbs are split in halves; the three half products
+// are independent and run on separate threads once the shorter operand has PARALLEL_MUL_LIMBS.
+// The threads come from a pool that is started once and kept for later products.
+const size_t KARATSUBA_LIMBS = 48;
+const size_t PARALLEL_MUL_LIMBS = 2048;
+
+// Degree of parallelism of mul for all threads. 1, the default, keeps products on the calling thread;
+// a larger value starts that many worker threads less one.
+void set_mul_threads(unsigned threads);
+
+unsigned mul_threads();
+
+// q = a / b, returns a % b. q may be a.
+uint32_t divrem_1(uint32_t* q, uint32_t const* a, size_t n, uint32_t b);
+
+// Long division (Knuth, TAOCP vol. 2, 4.3.1, algorithm D) of u[0, size) by v[0, n), where
+// size > n >= 2, the top bit of v[n - 1] is set and u[size - 1] < v[n - 1]. Writes size - n
+// quotient limbs to q and leaves the remainder in u[0, n).
+void divrem(uint32_t* q, uint32_t* u, size_t size, uint32_t const* v, size_t n);
+
+// r = a << shift with shift < 32, returns the bits shifted out. r may be a or lie above it.
+uint32_t lshift(uint32_t* r, uint32_t const* a, size_t n, unsigned shift);
+
+// r = a >> shift with shift < 32, returns the bits shifted out in the high end of a limb.
+// r may be a or lie below it.
+uint32_t rshift(uint32_t* r, uint32_t const* a, size_t n, unsigned shift);
+
+// Three-way comparison of a and b.
+int cmp(uint32_t const* a, uint32_t const* b, size_t n);
+
+// 64-bit hash of a[0, n) for hash tables, after wyhash: every four limbs are folded in with one
+// 64 x 64 -> 128 bit multiplication. Fast, but its constants are public, so it does not resist
+// inputs crafted to collide.
+uint64_t hash(uint32_t const* a, size_t n, uint64_t seed);
+
+// Products with both operands between RADIX52_MIN_LIMBS and RADIX52_MAX_LIMBS limbs (1k to 8k
+// bits) go through mul_radix52 when IFMA is enabled, which is the default on CPUs with
+// AVX-512 IFMA.
+const size_t RADIX52_MIN_LIMBS = 32;
+const size_t RADIX52_MAX_LIMBS = 256;
+
+// r[0, n + m) = a * b in radix 2^52 with vpmadd52luq/vpmadd52huq, for 0 < n, m <= RADIX52_MAX_LIMBS.
+// Without ifma the instructions are emulated in scalar code, which runs on any CPU.
+// r must not overlap a or b.
+void mul_radix52(uint32_t* r, uint32_t const* a, size_t n, uint32_t const* b, size_t m, bool ifma);
+
+bool ifma_supported();
+
+bool ifma_enabled();
+
+// Returns false if enabling is requested on a CPU without AVX-512 IFMA.
+bool use_ifma(bool enabled);
+
+// Struct-of-arrays limbs of BATCH_LANES independent numbers: limb i of number k is at
+// [i * BATCH_LANES + k], so that one AVX2 register holds one limb position of all of them.
+// Sizes count limb positions.
+const size_t BATCH_LANES = 8;
+
+// r[0, n + 1) = a + b in every lane, the last position holding the carries. r may be a or b.
+void add_lanes(uint32_t* r, uint32_t const* a, uint32_t const* b, size_t n, bool avx2);
+
+// r[0, n + m) = a * b in every lane, with n, m > 0. r must not overlap a or b.
+void mul_lanes(uint32_t* r, uint32_t const* a, size_t n, uint32_t const* b, size_t m, bool avx2);
+
+bool avx2_supported();
+
+// Implementations behind add_n, sub_n and addmul_1 (and so behind mul and divrem).
+// The best one the CPU supports is selected during static initialization.
+enum class kernel_set {
+    generic,    // C++ loops
+    x86_64,     // adc/sbb/mul assembly
+    adx,        // mulx with adcx/adox carry chains, needs BMI2 and ADX
+};
+
+kernel_set active_kernels();
+
+char const* kernel_set_name(kernel_set set);
+
+bool kernels_supported(kernel_set set);
+
+// Switches every thread to the given set, e.g. to test each set on one machine. Not safe to
+// call while other threads run arithmetic. Returns false if the set is not supported.
+bool use_kernels(kernel_set set);
+}
+
+#endif //BIGINT_LIMBS_H
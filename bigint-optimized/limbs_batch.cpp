@@ -0,0 +1,117 @@
+#include "limbs.h"
+
+#include <algorithm>
+
+#if defined(__x86_64__) && defined(__GNUC__)
+#define BIGINT_AVX2
+#include <immintrin.h>
+#endif
+
+// One ymm register holds the same limb of all BATCH_LANES numbers. Carries are kept per lane:
+// as 0/-1 masks in add, and in the high halves of 64-bit products in mul, where even and odd
+// lanes are multiplied separately by vpmuludq.
+namespace {
+const size_t LANES = limbs::BATCH_LANES;
+
+void add_scalar(uint32_t* r, uint32_t const* a, uint32_t const* b, size_t n) {
+    for (size_t lane = 0; lane < LANES; lane++) {
+        uint64_t carry = 0;
+        for (size_t i = 0; i < n; i++) {
+            uint64_t sum = static_cast<uint64_t>(a[i * LANES + lane]) + b[i * LANES + lane] + carry;
+            r[i * LANES + lane] = static_cast<uint32_t>(sum);
+            carry = sum >> 32;
+        }
+        r[n * LANES + lane] = static_cast<uint32_t>(carry);
+    }
+}
+
+void mul_scalar(uint32_t* r, uint32_t const* a, size_t n, uint32_t const* b, size_t m) {
+    for (size_t lane = 0; lane < LANES; lane++) {
+        for (size_t i = 0; i < n; i++) {
+            uint64_t carry = 0;
+            for (size_t j = 0; j < m; j++) {
+                uint32_t& limb = r[(i + j) * LANES + lane];
+                uint64_t product = static_cast<uint64_t>(a[i * LANES + lane]) * b[j * LANES + lane] + limb + carry;
+                limb = static_cast<uint32_t>(product);
+                carry = product >> 32;
+            }
+            r[(i + m) * LANES + lane] = static_cast<uint32_t>(carry);
+        }
+    }
+}
+
+#ifdef BIGINT_AVX2
+__attribute__((target("avx2")))
+void add_avx2(uint32_t* r, uint32_t const* a, uint32_t const* b, size_t n) {
+    // Unsigned comparison as signed comparison of values with the top bit flipped.
+    const __m256i bias = _mm256_set1_epi32(INT32_MIN);
+    const __m256i zero = _mm256_setzero_si256();
+    __m256i carry = zero;
+    for (size_t i = 0; i < n; i++) {
+        __m256i x = _mm256_loadu_si256(reinterpret_cast<__m256i const*>(a + i * LANES));
+        __m256i y = _mm256_loadu_si256(reinterpret_cast<__m256i const*>(b + i * LANES));
+        __m256i sum = _mm256_add_epi32(x, y);
+        __m256i wrapped = _mm256_cmpgt_epi32(_mm256_xor_si256(x, bias), _mm256_xor_si256(sum, bias));
+        __m256i total = _mm256_sub_epi32(sum, carry);
+        carry = _mm256_or_si256(wrapped, _mm256_and_si256(carry, _mm256_cmpeq_epi32(total, zero)));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(r + i * LANES), total);
+    }
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(r + n * LANES), _mm256_sub_epi32(zero, carry));
+}
+
+__attribute__((target("avx2")))
+void mul_avx2(uint32_t* r, uint32_t const* a, size_t n, uint32_t const* b, size_t m) {
+    const __m256i low_mask = _mm256_set1_epi64x(0xffffffff);
+    for (size_t i = 0; i < n; i++) {
+        __m256i x = _mm256_loadu_si256(reinterpret_cast<__m256i const*>(a + i * LANES));
+        __m256i x_odd = _mm256_srli_epi64(x, 32);
+        __m256i carry = _mm256_setzero_si256();
+        for (size_t j = 0; j < m; j++) {
+            __m256i y = _mm256_loadu_si256(reinterpret_cast<__m256i const*>(b + j * LANES));
+            __m256i* out = reinterpret_cast<__m256i*>(r + (i + j) * LANES);
+            __m256i limb = _mm256_loadu_si256(out);
+            // a * b + limb + carry < 2^64 for 32-bit a, b, limb and carry.
+            __m256i even = _mm256_add_epi64(_mm256_mul_epu32(x, y),
+                                            _mm256_add_epi64(_mm256_and_si256(limb, low_mask),
+                                                             _mm256_and_si256(carry, low_mask)));
+            __m256i odd = _mm256_add_epi64(_mm256_mul_epu32(x_odd, _mm256_srli_epi64(y, 32)),
+                                           _mm256_add_epi64(_mm256_srli_epi64(limb, 32),
+                                                            _mm256_srli_epi64(carry, 32)));
+            _mm256_storeu_si256(out, _mm256_blend_epi32(even, _mm256_slli_epi64(odd, 32), 0xaa));
+            carry = _mm256_blend_epi32(_mm256_srli_epi64(even, 32), odd, 0xaa);
+        }
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(r + (i + m) * LANES), carry);
+    }
+}
+#endif
+}
+
+void limbs::add_lanes(uint32_t* r, uint32_t const* a, uint32_t const* b, size_t n, bool avx2) {
+#ifdef BIGINT_AVX2
+    if (avx2) {
+        add_avx2(r, a, b, n);
+        return;
+    }
+#endif
+    add_scalar(r, a, b, n);
+}
+
+void limbs::mul_lanes(uint32_t* r, uint32_t const* a, size_t n, uint32_t const* b, size_t m, bool avx2) {
+    std::fill(r, r + (n + m) * LANES, 0);
+#ifdef BIGINT_AVX2
+    if (avx2) {
+        mul_avx2(r, a, n, b, m);
+        return;
+    }
+#endif
+    mul_scalar(r, a, n, b, m);
+}
+
+bool limbs::avx2_supported() {
+#ifdef BIGINT_AVX2
+    static bool const supported = __builtin_cpu_supports("avx2");
+    return supported;
+#else
+    return false;
+#endif
+}
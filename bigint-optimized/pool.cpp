@@ -0,0 +1,89 @@
+#include "pool.h"
+
+#include <new>
+
+namespace {
+size_t const CLASSES = 13;
+
+static_assert(size_class_pool::MIN_BLOCK << (CLASSES - 1) == size_class_pool::MAX_BLOCK,
+              "one free list per power of two");
+
+struct free_block {
+    free_block* next;
+};
+
+struct free_lists {
+    free_block* heads[CLASSES] = {};
+    size_t cached_bytes = 0;
+    pool_stats stats = {0, 0};
+
+    ~free_lists();
+};
+
+thread_local free_lists lists;
+// Numbers destroyed after the thread's lists (e.g. statics at exit) go straight to the heap.
+thread_local bool lists_destroyed = false;
+
+free_lists::~free_lists() {
+    for (size_t i = 0; i < CLASSES; i++) {
+        while (heads[i] != nullptr) {
+            free_block* next = heads[i]->next;
+            ::operator delete(heads[i]);
+            heads[i] = next;
+        }
+    }
+    lists_destroyed = true;
+}
+
+size_t class_of(size_t bytes) {
+    size_t index = 0;
+    while ((size_class_pool::MIN_BLOCK << index) < bytes) {
+        index++;
+    }
+    return index;
+}
+
+size_t class_size(size_t index) {
+    return size_class_pool::MIN_BLOCK << index;
+}
+}
+
+void* size_class_pool::allocate(size_t bytes) {
+    if (bytes > MAX_BLOCK || lists_destroyed) {
+        return ::operator new(bytes);
+    }
+    size_t index = class_of(bytes);
+    free_block* head = lists.heads[index];
+    if (head == nullptr) {
+        lists.stats.misses++;
+        return ::operator new(class_size(index));
+    }
+    lists.stats.hits++;
+    lists.heads[index] = head->next;
+    lists.cached_bytes -= class_size(index);
+    return head;
+}
+
+void size_class_pool::deallocate(void* p, size_t bytes) noexcept {
+    if (bytes > MAX_BLOCK || lists_destroyed) {
+        ::operator delete(p);
+        return;
+    }
+    size_t index = class_of(bytes);
+    if (lists.cached_bytes + class_size(index) > MAX_CACHED_BYTES) {
+        ::operator delete(p);
+        return;
+    }
+    free_block* block = static_cast<free_block*>(p);
+    block->next = lists.heads[index];
+    lists.heads[index] = block;
+    lists.cached_bytes += class_size(index);
+}
+
+pool_stats size_class_pool::stats() noexcept {
+    return lists.stats;
+}
+
+void size_class_pool::reset_stats() noexcept {
+    lists.stats = {0, 0};
+}
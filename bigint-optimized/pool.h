@@ -0,0 +1,32 @@
+#ifndef BIGINT_POOL_H
+#define BIGINT_POOL_H
+
+#include <cstddef>
+
+struct pool_stats {
+    size_t hits;
+    size_t misses;
+
+    double hit_rate() const noexcept {
+        return hits + misses == 0 ? 0 : static_cast<double>(hits) / (hits + misses);
+    }
+};
+
+// Thread-local free lists of power-of-two blocks from MIN_BLOCK to MAX_BLOCK bytes.
+// Blocks freed on a thread go to that thread's lists; larger requests bypass the pool.
+struct size_class_pool {
+    static const size_t MIN_BLOCK = 16;
+    static const size_t MAX_BLOCK = 64 * 1024;
+    static const size_t MAX_CACHED_BYTES = 1024 * 1024;
+
+    static void* allocate(size_t bytes);
+
+    static void deallocate(void* p, size_t bytes) noexcept;
+
+    // Counters of the calling thread.
+    static pool_stats stats() noexcept;
+
+    static void reset_stats() noexcept;
+};
+
+#endif //BIGINT_POOL_H
@@ -1,28 +1,66 @@
 #ifndef BIGINT_SHARED_VECTOR_H
 #define BIGINT_SHARED_VECTOR_H
 
-#include <vector>
-#include <cassert>
-
-template<typename T>
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <memory>
+#include <type_traits>
+
+#include "instrumentation.h"
+
+// Copy-on-write array. The reference counter, size, capacity, allocator and elements live in
+// a single block, so elements are one pointer hop away and every copy or spill costs one
+// allocation. A block grows and is freed through the allocator it was made with, whichever
+// copy does it; an empty vector uses Alloc().
+template<typename T, typename Alloc = std::allocator<T>>
 struct shared_vector {
-    shared_vector() noexcept {
-        inner = new inner_vector(std::vector<T>());
-    }
+    static_assert(std::is_trivially_copyable<T>::value, "elements are moved around as raw memory");
+
+    shared_vector() noexcept : inner(nullptr) {}
 
-    shared_vector(shared_vector<T> const& other) : inner(other.inner) {
-        inner->copies++;
+    shared_vector(shared_vector const& other)
+            : shared_vector(other, std::allocator_traits<Alloc>::select_on_container_copy_construction(
+                    other.get_allocator())) {}
+
+    // Shares the block of other if it comes from alloc, otherwise copies it into one from alloc.
+    shared_vector(shared_vector const& other, Alloc const& alloc) : inner(other.inner) {
+        if (inner == nullptr) {
+            return;
+        }
+        if (inner->alloc == alloc) {
+            acquire();
+        } else {
+            inner = create(other.begin(), other.end(), other.size(), alloc);
+        }
     }
 
-    shared_vector(T* begin, T* end) {
-        inner = new inner_vector(begin, end);
+    shared_vector(T const* begin, T const* end, Alloc const& alloc = Alloc())
+            : inner(create(begin, end, end - begin, alloc)) {}
+
+    // Copies [begin, end) into a block with room for at least capacity elements.
+    shared_vector(T const* begin, T const* end, size_t capacity, Alloc const& alloc = Alloc())
+            : inner(create(begin, end, std::max(capacity, static_cast<size_t>(end - begin)), alloc)) {}
+
+    shared_vector(shared_vector&& other) noexcept : inner(other.inner) {
+        other.inner = nullptr;
     }
 
+    // Keeps the allocator of this vector.
     shared_vector& operator=(shared_vector const& other) {
         if (inner != other.inner) {
+            shared_vector safe(other, get_allocator());
+            std::swap(inner, safe.inner);
+        }
+        return *this;
+    }
+
+    // Takes the block of other along with its allocator.
+    shared_vector& operator=(shared_vector&& other) noexcept {
+        if (this != &other) {
             destroy();
             inner = other.inner;
-            inner->copies++;
+            other.inner = nullptr;
         }
         return *this;
     }
@@ -32,53 +70,82 @@ struct shared_vector {
     }
 
     T& operator[](size_t i) noexcept {
-        copy_on_write();
-        return inner->vect[i];
+        prepare(size());
+        return data()[i];
     }
 
     const T& operator[](size_t i) const noexcept {
-        return inner->vect[i];
+        return data()[i];
     }
 
     size_t size() const noexcept {
-        return inner->vect.size();
+        return inner == nullptr ? 0 : inner->size;
     }
 
     T const& back() const noexcept {
-        return inner->vect.back();
+        return data()[size() - 1];
     }
 
     void push_back(T const& value) {
-        copy_on_write();
-        inner->vect.push_back(value);
+        T copy = value;
+        prepare(size() + 1);
+        data()[inner->size++] = copy;
     }
 
     void pop_back() {
-        copy_on_write();
-        inner->vect.pop_back();
+        prepare(size());
+        inner->size--;
     }
 
     bool empty() const noexcept {
         return size() == 0;
     }
 
+    size_t capacity() const noexcept {
+        return inner == nullptr ? 0 : inner->capacity;
+    }
+
+    Alloc get_allocator() const noexcept {
+        return inner == nullptr ? Alloc() : inner->alloc;
+    }
+
+    // Unlike growth on push_back, allocates exactly n elements (rounded up to the block unit).
+    // A shared block is copied as well, so that later writes up to n elements do not allocate.
+    void reserve(size_t n) {
+        bool shared = inner != nullptr && inner->copies.load(std::memory_order_acquire) > 1;
+        if (shared) {
+            BIGINT_COUNT_COW_COPY();
+        }
+        if (shared || n > capacity()) {
+            n = std::max(n, size());
+            header* copy = create(data(), data() + size(), n, get_allocator());
+            destroy();
+            inner = copy;
+        }
+    }
+
     void resize(size_t n) {
-        copy_on_write();
-        inner->vect.resize(n);
+        if (n == size()) {
+            return;
+        }
+        prepare(n);
+        if (n > inner->size) {
+            std::fill(data() + inner->size, data() + n, T());
+        }
+        inner->size = n;
     }
 
     T* begin() noexcept {
-        copy_on_write();
-        return inner->vect.data();
+        prepare(size());
+        return data();
     }
 
     T* end() noexcept {
-        copy_on_write();
         return begin() + size();
     }
 
     const T* begin() const noexcept {
-        return inner->vect.data();
+        return data();
     }
 
     const T* end() const noexcept {
@@ -86,32 +153,66 @@ struct shared_vector {
     }
 
 private:
-    struct inner_vector {
-        std::vector<T> vect;
-        size_t copies;
+    // The counter is atomic because copies may be shared between threads; the elements
+    // are only written by an owner that holds the sole reference.
+    struct header {
+        std::atomic<size_t> copies;
+        size_t size;
+        size_t capacity;
+        Alloc alloc;
+    };
 
-        inner_vector() : vect(), copies(1) {}
+    static_assert(alignof(T) <= alignof(header), "elements are placed right after the header");
 
-        explicit inner_vector(std::vector<T> const& other) : vect(other), copies(1) {}
+    using header_allocator = typename std::allocator_traits<Alloc>::template rebind_alloc<header>;
 
-        explicit inner_vector(T* begin, T* end) : vect(begin, end), copies(1) {}
+    header* inner;
 
-        ~inner_vector() = default;
-    };
+    T* data() const noexcept {
+        return inner == nullptr ? nullptr : reinterpret_cast<T*>(inner + 1);
+    }
 
-    inner_vector* inner;
+    // Blocks are allocated in header-sized units; the header takes the first one.
+    static size_t units_for(size_t capacity) noexcept {
+        return 1 + (capacity * sizeof(T) + sizeof(header) - 1) / sizeof(header);
+    }
+
+    static header* create(T const* begin, T const* end, size_t capacity, Alloc const& alloc) {
+        size_t units = units_for(capacity);
+        header* result = header_allocator(alloc).allocate(units);
+        new (result) header{{1}, static_cast<size_t>(end - begin), (units - 1) * sizeof(header) / sizeof(T), alloc};
+        if (begin != end) {
+            std::memcpy(reinterpret_cast<T*>(result + 1), begin, (end - begin) * sizeof(T));
+        }
+        return result;
+    }
 
-    void copy_on_write() {
-        if (inner->copies > 1) {
-            inner->copies--;
-            inner = new inner_vector(inner->vect);
+    void acquire() noexcept {
+        inner->copies.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    // Makes the block unshared and able to hold at least required elements.
+    void prepare(size_t required) {
+        bool shared = inner != nullptr && inner->copies.load(std::memory_order_acquire) > 1;
+        size_t current = capacity();
+        if (!shared && required <= current) {
+            return;
         }
+        if (shared) {
+            BIGINT_COUNT_COW_COPY();
+        }
+        size_t new_capacity = required <= current ? current : std::max(required, 2 * current);
+        header* copy = create(data(), data() + size(), new_capacity, get_allocator());
+        destroy();
+        inner = copy;
     }
 
     void destroy() {
-        inner->copies--;
-        if (inner->copies == 0) {
-            delete inner;
+        if (inner != nullptr && inner->copies.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+            size_t units = units_for(inner->capacity);
+            header_allocator alloc(inner->alloc);
+            inner->~header();
+            alloc.deallocate(inner, units);
         }
     }
 };
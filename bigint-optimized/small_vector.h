@@ -1,36 +1,76 @@
 #ifndef BIGINT_SMALL_VECTOR_H
 #define BIGINT_SMALL_VECTOR_H
 
+#include <cstring>
 #include <shared_vector.h>
 
-template<typename T>
+// Keeps up to InlineCapacity elements in place and spills to a shared_vector beyond that.
+// The big/small state, the size and one spare bit for the owner (flag) are packed into a
+// single word, so the object is exactly one word plus the inline buffer. The allocator lives
+// in the spilled block; a vector with its elements in place spills through Alloc().
+template<typename T, size_t InlineCapacity = sizeof(shared_vector<T>) / sizeof(T),
+         typename Alloc = std::allocator<T>>
 struct small_vector {
+    static_assert(InlineCapacity > 0, "at least one element must fit in place");
 
-    small_vector() noexcept: is_big(false), size_(0) {}
+    small_vector() noexcept: word(0) {}
 
-    small_vector(small_vector<T> const& other) :
-            is_big(other.is_big), size_(other.size_) {
+    small_vector(small_vector const& other) : word(other.word) {
         if (is_small()) {
-            copy_small(other.small, small, size_);
+            copy_small(other.small, small, size());
         } else {
-            new (&big) shared_vector<T>(other.big);
+            new (&big) shared_vector<T, Alloc>(other.big);
         }
     }
 
+    // A copy whose spilled elements, if any, come from alloc.
+    small_vector(small_vector const& other, Alloc const& alloc) : word(other.word) {
+        if (is_small()) {
+            copy_small(other.small, small, size());
+        } else {
+            new (&big) shared_vector<T, Alloc>(other.big, alloc);
+        }
+    }
+
+    // n value-initialized elements, spilled to a block from alloc if they do not fit in place.
+    small_vector(size_t n, Alloc const& alloc) : word(0) {
+        if (n > MAX_SIZE) {
+            new (&big) shared_vector<T, Alloc>(nullptr, nullptr, n, alloc);
+            word = BIG_BIT;
+        }
+        resize(n);
+    }
+
+    // Steals the heap block or copies the inline elements; other is left empty.
+    small_vector(small_vector&& other) noexcept : word(other.word) {
+        if (is_small()) {
+            std::memcpy(small, other.small, size() * sizeof(T));
+        } else {
+            new (&big) shared_vector<T, Alloc>(std::move(other.big));
+            other.big.~shared_vector();
+        }
+        other.word = 0;
+    }
+
+    // Keeps the allocator of this vector; the move assignment takes the one of other.
     small_vector& operator=(small_vector const& other) {
         if (this != &other) {
-            small_vector<T> safe(other);
+            small_vector safe(other, get_allocator());
             swap(safe);
         }
         return *this;
     }
 
-    ~small_vector() {
-        if (is_small()) {
-            clear_small(small, size_);
-        } else {
-            big.~shared_vector();
+    small_vector& operator=(small_vector&& other) noexcept {
+        if (this != &other) {
+            destroy();
+            new (this) small_vector(std::move(other));
         }
+        return *this;
+    }
+
+    ~small_vector() {
+        destroy();
     }
 
     T& operator[](size_t i) noexcept {
@@ -50,56 +90,81 @@ struct small_vector {
     }
 
     size_t size() const noexcept {
-        return size_;
+        return word >> SIZE_SHIFT;
+    }
+
+    bool flag() const noexcept {
+        return word & FLAG_BIT;
+    }
+
+    void set_flag(bool value) noexcept {
+        word = (word & ~FLAG_BIT) | (value ? FLAG_BIT : 0);
     }
 
     T const& back() const noexcept {
         if (is_small()) {
-            return small[size_ - 1];
+            return small[size() - 1];
         } else {
             return big.back();
         }
     }
 
     void push_back(T const& value) {
-        if (is_small() && size_ == MAX_SIZE) {
-            from_small_to_big();
-            big.push_back(value);
+        if (is_small() && size() == MAX_SIZE) {
+            T copy = value;
+            from_small_to_big(2 * MAX_SIZE);
+            big.push_back(copy);
         } else if (is_small()) {
-            small[size_] = value;
+            new (small + size()) T(value);
         } else {
             big.push_back(value);
         }
-        size_++;
+        set_size(size() + 1);
     }
 
     void pop_back() {
-        size_--;
+        set_size(size() - 1);
         if (is_small()) {
-            small[size_].~T();
+            small[size()].~T();
         } else {
             big.pop_back();
         }
     }
 
     bool empty() const noexcept {
-        return size_ == 0;
+        return size() == 0;
+    }
+
+    size_t capacity() const noexcept {
+        return is_small() ? MAX_SIZE : big.capacity();
+    }
+
+    Alloc get_allocator() const noexcept {
+        return is_small() ? Alloc() : big.get_allocator();
+    }
+
+    void reserve(size_t n) {
+        if (is_small() && n > MAX_SIZE) {
+            from_small_to_big(n);
+        } else if (!is_small()) {
+            big.reserve(n);
+        }
     }
 
     void resize(size_t n) {
-        if (size_ < n) {
+        if (size() < n) {
             if (is_small() && n > MAX_SIZE) {
-                from_small_to_big();
+                from_small_to_big(n);
             }
 
             if (is_small()) {
-                while (size_ < n) {
-                    new (small +  size_) T();
-                    size_++;
+                while (size() < n) {
+                    new (small + size()) T();
+                    set_size(size() + 1);
                 }
             } else {
                 big.resize(n);
-                size_ = n;
+                set_size(n);
             }
         }
     }
@@ -113,7 +178,7 @@ struct small_vector {
     }
 
     T* end() noexcept {
-        return begin() + size_;
+        return begin() + size();
     }
 
     const T* begin() const noexcept {
@@ -125,37 +190,52 @@ struct small_vector {
     }
 
     const T* end() const noexcept {
-        return begin() + size_;
+        return begin() + size();
     }
 
 private:
-    bool is_big;
-    size_t size_;
-    static constexpr size_t MAX_SIZE = sizeof(shared_vector<T>) / sizeof(T);
+    static constexpr size_t MAX_SIZE = InlineCapacity;
+    static constexpr size_t BIG_BIT = 1;
+    static constexpr size_t FLAG_BIT = 2;
+    static constexpr size_t SIZE_SHIFT = 2;
+
+    size_t word;
     union {
-        shared_vector<T> big;
+        shared_vector<T, Alloc> big;
         T small[MAX_SIZE];
     };
 
     bool is_small() const noexcept {
-        return !is_big;
+        return !(word & BIG_BIT);
+    }
+
+    void destroy() noexcept {
+        if (is_small()) {
+            clear_small(small, size());
+        } else {
+            big.~shared_vector();
+        }
+    }
+
+    void set_size(size_t n) noexcept {
+        word = (word & (BIG_BIT | FLAG_BIT)) | (n << SIZE_SHIFT);
     }
 
-    void from_small_to_big() {
-        shared_vector<T> new_big(small, small + size_);
-        clear_small(small, size_);
-        new (&big) shared_vector<T>(new_big);
-        is_big = true;
+    void from_small_to_big(size_t capacity) {
+        shared_vector<T, Alloc> new_big(small, small + size(), capacity);
+        clear_small(small, size());
+        new (&big) shared_vector<T, Alloc>(std::move(new_big));
+        word |= BIG_BIT;
     }
 
-    void swap_small_big_data(small_vector<T>& other) {
-        shared_vector<T> safe(other.big);
+    void swap_small_big_data(small_vector& other) {
+        shared_vector<T, Alloc> safe(std::move(other.big));
         other.big.~shared_vector();
-        copy_small(small, other.small, size_);
-        new (&big) shared_vector<T>(safe);
+        copy_small(small, other.small, size());
+        new (&big) shared_vector<T, Alloc>(std::move(safe));
     }
 
-    void swap(small_vector<T>& other) {
+    void swap(small_vector& other) {
         if (is_small() && other.is_small()) {
             std::swap(small, other.small);
         } else if (!is_small() && !other.is_small()) {
@@ -165,8 +245,7 @@ private:
         } else {
             other.swap_small_big_data(*this);
         }
-        std::swap(size_, other.size_);
-        std::swap(is_big, other.is_big);
+        std::swap(word, other.word);
     }
 
     void copy_small(T const* source, T* destination, size_t const& count) {
@@ -182,8 +261,8 @@ private:
         }
     }
 
-    void clear_small(T* where, size_t const& count) {
-        for (size_t i = 0; i < size_; i++) {
+    void clear_small(T* where, size_t const& count) noexcept {
+        for (size_t i = 0; i < count; i++) {
             where[i].~T();
         }
     }
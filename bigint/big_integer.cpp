@@ -1,4 +1,14 @@
 #include "big_integer.h"
+#include "decimal.h"
+#include "instrumentation.h"
+
+#include <cstring>
+#include <istream>
+#include <ostream>
+
+#ifdef __SIZEOF_INT128__
+__extension__ typedef unsigned __int128 uint128_t;
+#endif
 
 static uint32_t get_32_low_bits(uint64_t a) {
     return static_cast<uint32_t>(a & UINT32_MAX);
@@ -8,10 +18,6 @@ static uint32_t get_32_high_bits(uint64_t a) {
     return static_cast<uint32_t>(a >> big_integer::ELEMENT_LENGTH);
 }
 
-static bool get_sign(uint64_t a) {
-    return a >> 63u;
-}
-
 static uint64_t shift_from_low(uint32_t a) {
     return static_cast<uint64_t>(a) << big_integer::ELEMENT_LENGTH;
 }
@@ -25,10 +31,139 @@ void big_integer::normalize() {
     }
 }
 
+void big_integer::assign_limbs(uint32_t const* limbs, size_t size, bool negative) {
+    while (number.size() > size) {
+        number.pop_back();
+    }
+    number.resize(size);
+    std::copy(limbs, limbs + size, number.begin());
+    sign = negative;
+    normalize();
+}
+
+bool big_integer::is_small() const {
+    return number.size() <= SMALL_LIMBS;
+}
+
+uint64_t big_integer::to_uint64() const {
+    return (number.size() > 1 ? shift_from_low(number[1]) : 0) | (number.empty() ? 0 : number[0]);
+}
+
+void big_integer::assign_uint128(uint64_t low, uint64_t high, bool negative) {
+    uint32_t parts[] = {get_32_low_bits(low), get_32_high_bits(low), get_32_low_bits(high), get_32_high_bits(high)};
+    // Exactly the significant limbs, so that one- and two-limb results stay in the storage they have.
+    size_t size = high != 0 ? (parts[3] != 0 ? 4 : 3) : parts[1] != 0 ? 2 : parts[0] != 0 ? 1 : 0;
+    assign_limbs(parts, size, negative);
+}
+
+// Adds (or subtracts) operands of at most two limbs with native 64-bit arithmetic.
+// Returns false if the generic loop is needed.
+bool big_integer::add_small(big_integer const& rhs, bool subtract) {
+    if (!is_small() || !rhs.is_small()) {
+        return false;
+    }
+    uint64_t x = to_uint64();
+    uint64_t y = rhs.to_uint64();
+    bool rhs_sign = rhs.sign != subtract;
+    if (sign == rhs_sign) {
+        uint64_t sum = x + y;
+        assign_uint128(sum, sum < x, sign);
+    } else if (x >= y) {
+        assign_uint128(x - y, 0, sign);
+    } else {
+        assign_uint128(y - x, 0, rhs_sign);
+    }
+    return true;
+}
+
+bool big_integer::mul_small(big_integer const& rhs) {
+#ifdef __SIZEOF_INT128__
+    if (!is_small() || !rhs.is_small()) {
+        return false;
+    }
+    uint128_t product = static_cast<uint128_t>(to_uint64()) * rhs.to_uint64();
+    assign_uint128(static_cast<uint64_t>(product), static_cast<uint64_t>(product >> 64u), sign != rhs.sign);
+#else
+    if (number.size() > 1 || rhs.number.size() > 1) {
+        return false;
+    }
+    assign_uint128(to_uint64() * rhs.to_uint64(), 0, sign != rhs.sign);
+#endif
+    return true;
+}
+
+void big_integer::add_signed(big_integer const& rhs, bool rhs_negative) {
+    size_t n = number.size();
+    size_t m = rhs.number.size();
+    size_t size = std::max(n, m);
+    if (sign == rhs_negative) {
+        number.reserve(size + 1);
+        number.resize(size);
+        uint32_t* r = number.data();
+        uint32_t carry = limbs::add_n(r, r, rhs.number.data(), m);
+        carry = limbs::add_1(r + m, r + m, size - m, carry);
+        if (carry > 0) {
+            number.push_back(carry);
+        }
+        return;
+    }
+    if (compare_magnitude(*this, rhs) >= 0) {
+        uint32_t* r = number.data();
+        uint32_t borrow = limbs::sub_n(r, r, rhs.number.data(), m);
+        limbs::sub_1(r + m, r + m, n - m, borrow);
+    } else {
+        number.resize(m);
+        uint32_t* r = number.data();
+        limbs::sub_n(r, rhs.number.data(), r, m);
+        sign = rhs_negative;
+    }
+    normalize();
+}
+
+int big_integer::compare_magnitude(big_integer const& a, big_integer const& b) {
+    if (a.number.size() != b.number.size()) {
+        return a.number.size() < b.number.size() ? -1 : 1;
+    }
+    return limbs::cmp(a.number.data(), b.number.data(), a.number.size());
+}
+
+void big_integer::divide(big_integer const& a, big_integer const& b, big_integer& quotient, big_integer& remainder) {
+    size_t m = a.number.size();
+    size_t n = b.number.size();
+    quotient = big_integer();
+    remainder = big_integer();
+    if (m < n) {
+        remainder.assign_limbs(a.number.data(), m, false);
+        return;
+    }
+    quotient.number.resize(m - n + 1);
+    if (n == 1) {
+        uint32_t rest = limbs::divrem_1(quotient.number.data(), a.number.data(), m, b.number[0]);
+        remainder.assign_limbs(&rest, 1, false);
+        quotient.normalize();
+        return;
+    }
+    // Scale both operands so that the top bit of the divisor is set.
+    unsigned shift = 0;
+    while ((b.number[n - 1] << shift & 0x80000000u) == 0) {
+        shift++;
+    }
+    scratch_limbs v = scratch(n);
+    limbs::lshift(v.data(), b.number.data(), n, shift);
+    scratch_limbs u = scratch(m + 1);
+    u[m] = limbs::lshift(u.data(), a.number.data(), m, shift);
+    limbs::divrem(quotient.number.data(), u.data(), m + 1, v.data(), n);
+    limbs::rshift(u.data(), u.data(), n, shift);
+    remainder.assign_limbs(u.data(), n, false);
+    quotient.normalize();
+}
+
 big_integer::big_integer() : number(), sign(false) {}
 
 big_integer::big_integer(big_integer const& other) = default;
 
+big_integer::big_integer(big_integer&& other) noexcept = default;
+
 big_integer::big_integer(int a) : number(), sign(a < 0) {
     if (a == INT32_MIN) {
         set_nth(0, 0x80000000);
@@ -43,32 +178,64 @@ big_integer::big_integer(unsigned a) : number(), sign(false) {
     }
 }
 
-big_integer::big_integer(std::string const& str) : big_integer() {
-    if (str.empty()) {
+big_integer::big_integer(std::string const& str) : big_integer(str, 1) {}
+
+big_integer::big_integer(std::string const& str, unsigned threads) : big_integer() {
+    BIGINT_INSTRUMENT(from_string, decimal::limbs_for(str.size()));
+    bool csign = !str.empty() && str[0] == '-';
+    size_t count = str.size() - csign;
+    if (count == 0) {
         return;
     }
-    bool csign = str[0] == '-';
-    for (size_t i = csign; i < str.size(); i++) {
-        *this *= 10;
-        *this += str[i] - '0';
-    }
-    sign = (*this != 0 && csign);
+    std::vector<uint32_t> value(decimal::limbs_for(count));
+    assign_limbs(value.data(), decimal::from_digits(value.data(), str.data() + csign, count, threads), csign);
 }
 
 big_integer::~big_integer() = default;
 
 big_integer& big_integer::operator=(big_integer const& other) = default;
 
+// Steals the limbs: arena_allocator propagates on move assignment.
+static_assert(std::is_nothrow_move_assignable<std::vector<uint32_t, arena_allocator<uint32_t>>>::value,
+              "moving limbs must not allocate");
+
+big_integer& big_integer::operator=(big_integer&& other) noexcept = default;
+
+void big_integer::reserve(size_t bits) {
+    number.reserve((bits + ELEMENT_LENGTH - 1) / ELEMENT_LENGTH);
+}
+
 big_integer& big_integer::operator+=(big_integer const& rhs) {
-    return operator=(*this + rhs);
+    BIGINT_INSTRUMENT(add, number.size() + rhs.number.size());
+    if (!add_small(rhs, false)) {
+        add_signed(rhs, rhs.sign);
+    }
+    return *this;
 }
 
 big_integer& big_integer::operator-=(big_integer const& rhs) {
-    return operator=(*this - rhs);
+    BIGINT_INSTRUMENT(sub, number.size() + rhs.number.size());
+    if (!add_small(rhs, true)) {
+        add_signed(rhs, !rhs.sign);
+    }
+    return *this;
 }
 
 big_integer& big_integer::operator*=(big_integer const& rhs) {
-    return operator=(*this * rhs);
+    BIGINT_INSTRUMENT(mul, number.size() + rhs.number.size());
+    if (mul_small(rhs)) {
+        return *this;
+    }
+    // The product comes from the allocator of *this, so that it can take its place.
+    size_t size = number.empty() || rhs.number.empty() ? 0 : number.size() + rhs.number.size();
+    decltype(number) product(size, number.get_allocator());
+    if (size != 0) {
+        limbs::mul(product.data(), number.data(), number.size(), rhs.number.data(), rhs.number.size());
+    }
+    number = std::move(product);
+    sign = sign != rhs.sign;
+    normalize();
+    return *this;
 }
 
 big_integer& big_integer::operator/=(big_integer const& rhs) {
@@ -94,11 +261,39 @@ big_integer& big_integer::operator^=(big_integer const& rhs) {
 }
 
 big_integer& big_integer::operator<<=(int rhs) {
-    return operator=(*this << rhs);
+    BIGINT_INSTRUMENT(shl, number.size());
+    unsigned bits = static_cast<unsigned>(rhs);
+    size_t zeros = bits / ELEMENT_LENGTH;
+    unsigned shift = bits % ELEMENT_LENGTH;
+    size_t size = number.size();
+    number.resize(size + zeros + 1);
+    uint32_t* r = number.data();
+    r[size + zeros] = limbs::lshift(r + zeros, r, size, shift);
+    std::fill(r, r + zeros, 0);
+    normalize();
+    return *this;
 }
 
+// Rounds towards negative infinity, like the shift of a two's complement number.
 big_integer& big_integer::operator>>=(int rhs) {
-    return operator=(*this >> rhs);
+    BIGINT_INSTRUMENT(shr, number.size());
+    unsigned bits = static_cast<unsigned>(rhs);
+    size_t size = number.size();
+    size_t zeros = std::min(static_cast<size_t>(bits / ELEMENT_LENGTH), size);
+    unsigned shift = bits % ELEMENT_LENGTH;
+    bool negative = sign;
+    uint32_t* r = number.data();
+    bool inexact = std::any_of(r, r + zeros, [](uint32_t x) { return x != 0; });
+    inexact |= limbs::rshift(r, r + zeros, size - zeros, shift) != 0;
+    std::fill(r + size - zeros, r + size, 0);
+    sign = false;
+    normalize();
+    if (negative && inexact) {
+        ++*this;
+    }
+    sign = negative;
+    normalize();
+    return *this;
 }
 
 big_integer big_integer::operator+() const {
@@ -106,6 +301,7 @@ big_integer big_integer::operator+() const {
 }
 
 big_integer big_integer::operator-() const {
+    BIGINT_INSTRUMENT(neg, number.size());
     big_integer r(*this);
     if (r != 0) {
         r.sign = !r.sign;
@@ -138,131 +334,49 @@ big_integer big_integer::operator--(int) {
 }
 
 big_integer operator+(big_integer a, big_integer const& b) {
-    if (a.sign && b.sign) {
-        return -(-a + (-b));
-    } else if (!a.sign && b.sign) {
-        return a - (-b);
-    } else if (a.sign && !b.sign) {
-        return b - (-a);
-    }
-    uint32_t carry = 0;
-    for (size_t i = 0; i < a.number.size() || i < b.number.size(); i++) {
-        uint64_t x = a.get_nth(i);
-        uint64_t y = b.get_nth(i);
-        uint64_t sum = x + y + carry;
-        uint32_t result = get_32_low_bits(sum);
-        carry = get_32_high_bits(sum);
-        a.set_nth(i, result);
-    }
-    if (carry > 0) {
-        a.number.push_back(carry);
-    }
+    BIGINT_INSTRUMENT(add, a.number.size() + b.number.size());
+    a += b;
     return a;
 }
 
 big_integer operator-(big_integer a, big_integer const& b) {
-    if (a.sign && b.sign) {
-        return (-b) - (-a);
-    } else if (a.sign && !b.sign) {
-        return -(-a + b);
-    } else if (!a.sign && b.sign) {
-        return a + (-b);
-    } else if (a < b) {
-        return -(b - a);
-    }
-
-    uint32_t carry = 0;
-    for (size_t i = 0; i < a.number.size() || i < b.number.size(); i++) {
-        uint64_t x = a.get_nth(i);
-        uint32_t y = b.get_nth(i);
-        uint64_t diff = x - y - carry;
-        a.set_nth(i, get_32_low_bits(diff));
-        carry = get_sign(diff);
-    }
-    a.normalize();
+    BIGINT_INSTRUMENT(sub, a.number.size() + b.number.size());
+    a -= b;
     return a;
 }
 
 big_integer operator*(big_integer a, big_integer const& b) {
-    if (a.sign != b.sign) {
-        return -(-a * b);
-    }
-    big_integer result;
-    for (size_t i = 0; i < a.number.size(); i++) {
-        uint32_t carry = 0;
-        uint64_t x = a.number[i];
-        for (size_t j = 0; j < b.number.size() || carry > 0; j++) {
-            uint64_t y = j < b.number.size() ? b.number[j] : 0;
-            uint64_t mul = result.get_nth(i + j) + x * y + carry;
-            result.set_nth(i + j, get_32_low_bits(mul));
-            carry = get_32_high_bits(mul);
-        }
-    }
-    result.normalize();
-    return result;
-}
-
-big_integer big_integer::div_by_uint(uint32_t b) {
-    uint32_t carry = 0;
-    for (ptrdiff_t i = number.size() - 1; i >= 0; i--) {
-        uint64_t tmp = shift_from_low(carry) + number[i];
-        number[i] = get_32_low_bits(tmp / b);
-        carry = tmp % b;
-    }
-    normalize();
-    return *this;
+    BIGINT_INSTRUMENT(mul, a.number.size() + b.number.size());
+    a *= b;
+    return a;
 }
 
 big_integer operator/(big_integer a, big_integer const& b) {
-    if (a.sign != b.sign) {
-        return -((-a) / b);
-    } else if (a.number.size() < b.number.size()) {
-        return 0;
-    } else if (b.number.size() == 1) {
-        if (a.sign) {
-            return (-a).div_by_uint(b.number[0]);
-        } else {
-            return a.div_by_uint(b.number[0]);
-        }
+    BIGINT_INSTRUMENT(div, a.number.size() + b.number.size());
+    if (a.is_small() && b.is_small()) {
+        a.assign_uint128(a.to_uint64() / b.to_uint64(), 0, a.sign != b.sign);
+        return a;
     }
-    uint32_t f = static_cast<uint32_t>(shift_from_low(1) / (static_cast<uint64_t> (b.number.back() + 1)));
-    big_integer norm_a = a * f;
-    big_integer norm_b = b * f;
-    if (a.sign) {
-        norm_a = -norm_a;
-        norm_b = -norm_b;
-    }
-    size_t n = norm_b.number.size();
-    size_t m = norm_a.number.size() - norm_b.number.size();
-    big_integer result;
-    result.number.resize(m);
-    if (norm_a >= (norm_b << 32 * m)) {
-        result.number.push_back(1);
-        norm_a -= (norm_b << 32 * m);
-    }
-    for (ptrdiff_t i = m - 1; i >= 0; i--) {
-        uint64_t x = norm_a.get_nth(n + i);
-        uint64_t y = norm_a.get_nth(n + i - 1);
-        uint64_t q64 = (shift_from_low(x) + y) / norm_b.number[n - 1];
-        uint32_t q = UINT32_MAX;
-        if (q64 < q) q = get_32_low_bits(q64);
-        big_integer big_q(q);
-        norm_a -= ((big_q * norm_b) << (32 * i));
-        while (norm_a < 0) {
-            q--;
-            norm_a += (norm_b << (32 * i));
-        }
-        result.number[i] = q;
-        if (norm_a == 0) {
-            break;
-        }
-    }
-    result.normalize();
-    return result;
+    big_integer quotient;
+    big_integer remainder;
+    big_integer::divide(a, b, quotient, remainder);
+    quotient.sign = a.sign != b.sign;
+    quotient.normalize();
+    return quotient;
 }
 
 big_integer operator%(const big_integer& a, big_integer const& b) {
-    return a - (a / b) * b;
+    BIGINT_INSTRUMENT(mod, a.number.size() + b.number.size());
+    big_integer quotient;
+    big_integer remainder;
+    if (a.is_small() && b.is_small()) {
+        remainder.assign_uint128(a.to_uint64() % b.to_uint64(), 0, a.sign);
+        return remainder;
+    }
+    big_integer::divide(a, b, quotient, remainder);
+    remainder.sign = a.sign;
+    remainder.normalize();
+    return remainder;
 }
 
 void big_integer::to_bits() {
@@ -291,7 +405,7 @@ void big_integer::from_bits() {
 big_integer bit_operation(big_integer a, big_integer b, const big_integer::func& func) {
     a.to_bits();
     b.to_bits();
-    for (size_t i = 0; i < a.number.size(); i++) {
+    for (size_t i = 0; i < a.number.size() || i < b.number.size(); i++) {
         a.set_nth(i, func(a.get_nth(i), b.get_nth(i)));
     }
     a.normalize();
@@ -303,81 +417,50 @@ big_integer bit_operation(big_integer a, big_integer b, const big_integer::func&
 }
 
 big_integer operator&(const big_integer& a, big_integer const& b) {
+    BIGINT_INSTRUMENT(bit_and, a.number.size() + b.number.size());
     return bit_operation(a, b, [](uint32_t a, uint32_t b) { return a & b; });
 }
 
 big_integer operator|(const big_integer& a, big_integer const& b) {
+    BIGINT_INSTRUMENT(bit_or, a.number.size() + b.number.size());
     return bit_operation(a, b, [](uint32_t a, uint32_t b) { return a | b; });
 }
 
 big_integer operator^(const big_integer& a, big_integer const& b) {
+    BIGINT_INSTRUMENT(bit_xor, a.number.size() + b.number.size());
     return bit_operation(a, b, [](uint32_t a, uint32_t b) { return a ^ b; });
 }
 
 big_integer operator<<(big_integer a, unsigned int b) {
-    ptrdiff_t zeros = static_cast<ptrdiff_t>(b) >> 5u;
-    uint32_t shift = static_cast<size_t>(b) & 31u;
-    uint32_t carry = 0;
-    for (uint32_t& i : a.number) {
-        uint64_t tmp = (static_cast<uint64_t>( i) << shift);
-        tmp |= carry;
-        i = get_32_low_bits(tmp);
-        carry = get_32_high_bits(tmp);
-    }
-    if (carry > 0) {
-        a.number.push_back(carry);
-    }
-    a.number.resize(a.number.size() + zeros);
-    for (ptrdiff_t i = a.number.size() - 1; i >= zeros; i--) {
-        a.number[i] = a.number[i - zeros];
-    }
-    for (ptrdiff_t i = 0; i < zeros; i++) {
-        a.number[i] = 0;
-    }
+    BIGINT_INSTRUMENT(shl, a.number.size());
+    a <<= static_cast<int>(b);
     return a;
 }
 
 big_integer operator>>(big_integer a, unsigned int b) {
-    size_t zeros = static_cast<size_t> (b) >> 5u;
-    size_t shift = static_cast<size_t> (b) & 31u;
-    uint32_t carry = 0;
-    for (size_t i = 0; i < a.number.size() - zeros; i++) {
-        a.number[i] = a.number[i + zeros];
-    }
-    for (size_t i = 0; i < zeros; i++)
-        a.number.pop_back();
-    for (ptrdiff_t i = a.number.size() - 1; i >= 0; i--) {
-        uint64_t tmp = (static_cast<uint64_t>(a.number[i]) << (32 - shift));
-        a.number[i] = (get_32_high_bits(tmp) | carry);
-        carry = get_32_low_bits(tmp);
-    }
-    a.normalize();
-    if (a.sign)
-        a--;
+    BIGINT_INSTRUMENT(shr, a.number.size());
+    a >>= static_cast<int>(b);
     return a;
 }
 
 int8_t compare(const big_integer& a, const big_integer& b) {
+    BIGINT_INSTRUMENT(compare, a.number.size() + b.number.size());
     if (a.sign && !b.sign) {
         return -1;
     } else if (!a.sign && b.sign) {
         return 1;
     }
     int8_t result = 0;
-    if (a.number.size() < b.number.size()) {
+    if (a.is_small() && b.is_small()) {
+        uint64_t x = a.to_uint64();
+        uint64_t y = b.to_uint64();
+        result = x < y ? -1 : x > y;
+    } else if (a.number.size() < b.number.size()) {
         result = -1;
     } else if (a.number.size() > b.number.size()) {
         result = 1;
     } else {
-        for (ptrdiff_t i = a.number.size() - 1; i >= 0; i--) {
-            if (a.number[i] < b.number[i]) {
-                result = -1;
-                break;
-            } else if (a.number[i] > b.number[i]) {
-                result = 1;
-                break;
-            }
-        }
+        result = static_cast<int8_t>(big_integer::compare_magnitude(a, b));
     }
     if (a.sign) {
         result = -result;
@@ -410,26 +493,244 @@ bool operator>=(big_integer const& a, big_integer const& b) {
 }
 
 std::string to_string(big_integer const& a) {
-    if (a == 0) {
-        return "0";
+    return to_string(a, 1);
+}
+
+// Digits that write_fixed produces for n > 0 limbs.
+static size_t fixed_width(size_t n, unsigned base) {
+    if (base == 10) {
+        return decimal::chunks_for(n) * decimal::CHUNK_DIGITS;
+    }
+    unsigned bits = 1;
+    while ((2u << bits) <= base) {
+        bits++;
     }
-    std::string result;
-    big_integer temp(a);
-    while (temp != 0) {
-        uint64_t digit = 0;
-        for (ptrdiff_t i = temp.number.size() - 1; i >= 0; i--) {
-            digit = (shift_from_low(digit) + temp.number[i]) % 10;
+    size_t width = (n * big_integer::ELEMENT_LENGTH + bits - 1) / bits;
+    if ((base & (base - 1)) == 0) {
+        return width;
+    }
+    size_t per_chunk = 1;
+    for (uint32_t power = base; power <= UINT32_MAX / base; power *= base) {
+        per_chunk++;
+    }
+    return (width + per_chunk - 1) / per_chunk * per_chunk;
+}
+
+// Writes a[0, n) as exactly fixed_width(n, base) digits, with leading zeros. Powers of two are
+// read off the bits, base 10 goes through decimal::to_digits and other bases are peeled off by
+// divrem_1 in chunks of as many digits as a limb holds.
+static void write_fixed(char* out, uint32_t const* a, size_t n, unsigned base, unsigned threads) {
+    static const char SYMBOLS[] = "0123456789abcdefghijklmnopqrstuvwxyz";
+    size_t width = fixed_width(n, base);
+    if ((base & (base - 1)) == 0) {
+        unsigned bits = 1;
+        while ((2u << bits) <= base) {
+            bits++;
         }
-        result += std::to_string(digit);
-        temp = temp / 10;
+        for (size_t i = 0; i < width; i++) {
+            size_t q = i * bits / big_integer::ELEMENT_LENGTH;
+            unsigned shift = i * bits % big_integer::ELEMENT_LENGTH;
+            uint64_t window = a[q] | (q + 1 < n ? shift_from_low(a[q + 1]) : 0);
+            out[width - 1 - i] = SYMBOLS[(window >> shift) & (base - 1)];
+        }
+        return;
     }
-    if (a.sign) {
-        result += '-';
+    // to_digits and divrem_1 consume their input.
+    const size_t LOCAL_LIMBS = 64;
+    uint32_t local[LOCAL_LIMBS];
+    std::vector<uint32_t> heap;
+    uint32_t* rest = local;
+    if (n > LOCAL_LIMBS) {
+        heap.assign(a, a + n);
+        rest = heap.data();
+    } else {
+        std::copy(a, a + n, local);
+    }
+    if (base == 10) {
+        decimal::to_digits(out, width / decimal::CHUNK_DIGITS, rest, n, threads);
+        return;
     }
-    std::reverse(result.begin(), result.end());
+    uint32_t chunk_base = base;
+    size_t per_chunk = 1;
+    while (chunk_base <= UINT32_MAX / base) {
+        chunk_base *= base;
+        per_chunk++;
+    }
+    for (char* end = out + width; end != out; end -= per_chunk) {
+        uint32_t chunk = limbs::divrem_1(rest, rest, n, chunk_base);
+        while (n > 0 && rest[n - 1] == 0) {
+            n--;
+        }
+        std::fill(end - per_chunk, end, '0');
+        for (char* digit = end; chunk > 0; chunk /= base) {
+            *--digit = SYMBOLS[chunk % base];
+        }
+    }
+}
+
+std::string to_string(big_integer const& a, unsigned threads) {
+    BIGINT_INSTRUMENT(to_string, a.number.size());
+    if (a.number.empty()) {
+        return "0";
+    }
+    std::string result(a.sign + fixed_width(a.number.size(), 10), '-');
+    write_fixed(&result[a.sign], a.number.data(), a.number.size(), 10, threads);
+    result.erase(a.sign, result.find_first_not_of('0', a.sign) - a.sign);
     return result;
 }
 
+std::to_chars_result to_chars(char* first, char* last, big_integer const& a, int base) {
+    BIGINT_INSTRUMENT(to_string, a.number.size());
+    if (base < 2 || base > 36) {
+        return {last, std::errc::invalid_argument};
+    }
+    size_t room = static_cast<size_t>(last - first);
+    if (a.number.empty()) {
+        if (room == 0) {
+            return {last, std::errc::value_too_large};
+        }
+        *first = '0';
+        return {first + 1, std::errc()};
+    }
+    size_t sign = a.sign;
+    size_t width = fixed_width(a.number.size(), static_cast<unsigned>(base));
+    // Digits go with their leading zeros into the output if it has room for them, else aside.
+    std::vector<char> spill;
+    char* out = first + sign;
+    if (room < sign + width) {
+        spill.resize(width);
+        out = spill.data();
+    }
+    write_fixed(out, a.number.data(), a.number.size(), static_cast<unsigned>(base), 1);
+    size_t zeros = 0;
+    while (out[zeros] == '0') {
+        zeros++;
+    }
+    size_t length = width - zeros;
+    if (room < sign + length) {
+        return {last, std::errc::value_too_large};
+    }
+    if (sign) {
+        *first = '-';
+    }
+    std::memmove(first + sign, out + zeros, length);
+    return {first + sign + length, std::errc()};
+}
+
+size_t max_digits(big_integer const& a, int base) {
+    if (a.number.empty() || base < 2 || base > 36) {
+        return 1;
+    }
+    return a.sign + fixed_width(a.number.size(), static_cast<unsigned>(base));
+}
+
+void big_integer::store_lane(uint32_t* block, size_t width, size_t lane) const {
+    uint32_t const* in = number.data();
+    size_t size = std::min(width, number.size());
+    for (size_t i = 0; i < size; i++) {
+        block[i * limbs::BATCH_LANES + lane] = in[i];
+    }
+    for (size_t i = size; i < width; i++) {
+        block[i * limbs::BATCH_LANES + lane] = 0;
+    }
+}
+
+void big_integer::load_lane(uint32_t const* block, size_t width, size_t lane, bool negative) {
+    size_t size = width;
+    while (size > 0 && block[(size - 1) * limbs::BATCH_LANES + lane] == 0) {
+        size--;
+    }
+    while (number.size() > size) {
+        number.pop_back();
+    }
+    number.resize(size);
+    uint32_t* out = number.data();
+    for (size_t i = 0; i < size; i++) {
+        out[i] = block[i * limbs::BATCH_LANES + lane];
+    }
+    sign = negative && size > 0;
+}
+
+// Two's complement negation of one lane of a struct-of-arrays block.
+static void negate_lane(uint32_t* block, size_t width, size_t lane) {
+    uint64_t carry = 1;
+    for (size_t i = 0; i < width; i++) {
+        uint32_t& limb = block[i * limbs::BATCH_LANES + lane];
+        carry += static_cast<uint32_t>(~limb);
+        limb = get_32_low_bits(carry);
+        carry >>= 32;
+    }
+}
+
+void add_batch(big_integer const* a, big_integer const* b, big_integer* r, size_t count) {
+    const size_t lanes = limbs::BATCH_LANES;
+    bool avx2 = limbs::avx2_supported();
+    std::vector<uint32_t> x;
+    std::vector<uint32_t> y;
+    std::vector<uint32_t> sum;
+    for (size_t begin = 0; begin < count; begin += lanes) {
+        size_t group = std::min(lanes, count - begin);
+        // One limb more than the widest operand holds the sign of the sum.
+        size_t width = 1;
+        for (size_t k = 0; k < group; k++) {
+            width = std::max(width, std::max(a[begin + k].number.size(), b[begin + k].number.size()) + 1);
+        }
+        x.assign(width * lanes, 0);
+        y.assign(width * lanes, 0);
+        sum.resize((width + 1) * lanes);
+        for (size_t k = 0; k < group; k++) {
+            a[begin + k].store_lane(x.data(), width, k);
+            if (a[begin + k].sign) {
+                negate_lane(x.data(), width, k);
+            }
+            b[begin + k].store_lane(y.data(), width, k);
+            if (b[begin + k].sign) {
+                negate_lane(y.data(), width, k);
+            }
+        }
+        limbs::add_lanes(sum.data(), x.data(), y.data(), width, avx2);
+        for (size_t k = 0; k < group; k++) {
+            bool negative = sum[(width - 1) * lanes + k] >> 31;
+            if (negative) {
+                negate_lane(sum.data(), width, k);
+            }
+            r[begin + k].load_lane(sum.data(), width, k, negative);
+        }
+    }
+}
+
+void mul_batch(big_integer const* a, big_integer const* b, big_integer* r, size_t count) {
+    const size_t lanes = limbs::BATCH_LANES;
+    bool avx2 = limbs::avx2_supported();
+    std::vector<uint32_t> x;
+    std::vector<uint32_t> y;
+    std::vector<uint32_t> product;
+    for (size_t begin = 0; begin < count; begin += lanes) {
+        size_t group = std::min(lanes, count - begin);
+        size_t n = 0;
+        size_t m = 0;
+        for (size_t k = 0; k < group; k++) {
+            n = std::max(n, a[begin + k].number.size());
+            m = std::max(m, b[begin + k].number.size());
+        }
+        if (n == 0 || m == 0) {
+            std::fill(r + begin, r + begin + group, 0);
+            continue;
+        }
+        x.assign(n * lanes, 0);
+        y.assign(m * lanes, 0);
+        product.resize((n + m) * lanes);
+        for (size_t k = 0; k < group; k++) {
+            a[begin + k].store_lane(x.data(), n, k);
+            b[begin + k].store_lane(y.data(), m, k);
+        }
+        limbs::mul_lanes(product.data(), x.data(), n, y.data(), m, avx2);
+        for (size_t k = 0; k < group; k++) {
+            r[begin + k].load_lane(product.data(), n + m, k, a[begin + k].sign != b[begin + k].sign);
+        }
+    }
+}
+
 uint32_t big_integer::get_nth(size_t i) const {
     if (i < number.size()) {
         return number[i];
@@ -445,6 +746,219 @@ void big_integer::set_nth(size_t i, uint32_t value) {
     }
 }
 
+static bool pad(std::streambuf* out, char fill, std::streamsize count) {
+    for (; count > 0; count--) {
+        if (std::ostream::traits_type::eq_int_type(out->sputc(fill), std::ostream::traits_type::eof())) {
+            return false;
+        }
+    }
+    return true;
+}
+
+namespace {
+// Passes digits that arrive in pieces to a stream buffer, dropping the leading zeros. Padding to
+// the stream width needs only the first significant piece and the count of digits still to come.
+struct stream_writer {
+    stream_writer(std::ostream& s, std::string prefix)
+        : out(s.rdbuf()), prefix(std::move(prefix)), width(s.width()), fill(s.fill()),
+          adjust(s.flags() & std::ios_base::adjustfield) {}
+
+    void write(char const* digits, size_t count, size_t after) {
+        if (!started) {
+            size_t zeros = 0;
+            while (zeros < count && digits[zeros] == '0') {
+                zeros++;
+            }
+            if (zeros == count) {
+                if (after > 0) {
+                    return;
+                }
+                // The number is zero.
+                zeros--;
+            }
+            start(count - zeros + after);
+            digits += zeros;
+            count -= zeros;
+        }
+        written = written && out->sputn(digits, count) == static_cast<std::streamsize>(count);
+    }
+
+    bool finish() {
+        return written && pad(out, fill, trailing);
+    }
+
+private:
+    void start(size_t digits) {
+        started = true;
+        std::streamsize length = static_cast<std::streamsize>(prefix.size() + digits);
+        std::streamsize padding = std::max(width - length, static_cast<std::streamsize>(0));
+        if (adjust == std::ios_base::left) {
+            trailing = padding;
+        } else if (adjust != std::ios_base::internal) {
+            written = pad(out, fill, padding);
+        }
+        // Internal adjustment pads between the sign and base prefix and the digits.
+        written = written && out->sputn(prefix.data(), prefix.size()) == static_cast<std::streamsize>(prefix.size());
+        written = written && (adjust != std::ios_base::internal || pad(out, fill, padding));
+    }
+
+    std::streambuf* out;
+    std::string prefix;
+    std::streamsize width;
+    char fill;
+    std::ios_base::fmtflags adjust;
+    bool started = false;
+    bool written = true;
+    std::streamsize trailing = 0;
+};
+}
+
+// Hands the digits to the stream buffer a piece at a time, so a long number is never held as
+// text: base 10 goes through the streaming decimal::to_digits, hex and octal are read off slices
+// of the limbs. basefield, showbase, showpos, uppercase, width, fill and adjustfield apply like
+// for the built-in inserters, with a sign in front of the magnitude.
 std::ostream& operator<<(std::ostream& s, big_integer const& a) {
-    return s << to_string(a);
+    std::ostream::sentry ready(s);
+    if (!ready) {
+        return s;
+    }
+    std::ios_base::fmtflags flags = s.flags();
+    std::ios_base::fmtflags basefield = flags & std::ios_base::basefield;
+    unsigned base = basefield == std::ios_base::hex ? 16 : basefield == std::ios_base::oct ? 8 : 10;
+    bool upper = (flags & std::ios_base::uppercase) != 0;
+    std::string prefix = a.sign ? "-" : flags & std::ios_base::showpos ? "+" : "";
+    if (flags & std::ios_base::showbase && base != 10 && !a.number.empty()) {
+        prefix += base == 8 ? "0" : upper ? "0X" : "0x";
+    }
+    stream_writer out(s, prefix);
+    s.width(0);
+    size_t n = a.number.size();
+    if (n == 0) {
+        out.write("0", 1, 0);
+    } else if (base == 10) {
+        // to_digits consumes its input.
+        const size_t LOCAL_LIMBS = 64;
+        uint32_t local[LOCAL_LIMBS];
+        scratch_limbs heap;
+        uint32_t* rest = local;
+        if (n > LOCAL_LIMBS) {
+            heap = scratch(n);
+            rest = heap.data();
+        }
+        std::copy(a.number.begin(), a.number.end(), rest);
+        decimal::to_digits([&out](char const* digits, size_t count, size_t after) {
+            out.write(digits, count, after);
+        }, decimal::chunks_for(n), rest, n);
+    } else {
+        // Slices of whole limbs that hold a whole number of digits, most significant first.
+        const size_t SLICE_DIGITS = 1024;
+        size_t slice = SLICE_DIGITS * (base == 16 ? 4 : 3) / big_integer::ELEMENT_LENGTH;
+        char text[SLICE_DIGITS];
+        for (size_t begin = (n - 1) / slice * slice;; begin -= slice) {
+            size_t size = std::min(slice, n - begin);
+            size_t count = fixed_width(size, base);
+            write_fixed(text, a.number.data() + begin, size, base, 1);
+            if (upper) {
+                std::transform(text, text + count, text, [](char c) {
+                    return c >= 'a' ? static_cast<char>(c - 'a' + 'A') : c;
+                });
+            }
+            out.write(text, count, begin / slice * SLICE_DIGITS);
+            if (begin == 0) {
+                break;
+            }
+        }
+    }
+    if (!out.finish()) {
+        s.setstate(std::ios_base::badbit);
+    }
+    return s;
+}
+
+namespace {
+// The get area of a stream buffer. Its accessors are protected, but a derived class may take
+// pointers to them and those apply to any stream buffer.
+struct get_area : std::streambuf {
+    static char const* begin(std::streambuf* buffer) {
+        return (buffer->*&get_area::gptr)();
+    }
+
+    static char const* end(std::streambuf* buffer) {
+        return (buffer->*&get_area::egptr)();
+    }
+
+    static void consume(std::streambuf* buffer, size_t count) {
+        (buffer->*&get_area::gbump)(static_cast<int>(count));
+    }
+};
+}
+
+// Scans the get area of the stream buffer for runs of digits and hands each run to a
+// decimal::accumulator, which writes the value into the limbs of a once the digits end.
+// Buffers without a get area are read a character at a time.
+std::istream& operator>>(std::istream& s, big_integer& a) {
+    std::istream::sentry ready(s);
+    if (!ready) {
+        return s;
+    }
+    using traits = std::istream::traits_type;
+    std::streambuf* in = s.rdbuf();
+    traits::int_type c = in->sgetc();
+    bool csign = traits::eq_int_type(c, traits::to_int_type('-'));
+    if (csign || traits::eq_int_type(c, traits::to_int_type('+'))) {
+        in->sbumpc();
+    }
+    decimal::accumulator digits;
+    size_t total = 0;
+    for (;;) {
+        char const* first = get_area::begin(in);
+        char const* last = get_area::end(in);
+        if (first == last) {
+            c = in->sgetc();
+            if (traits::eq_int_type(c, traits::eof())) {
+                s.setstate(std::ios_base::eofbit);
+                break;
+            }
+            if (get_area::begin(in) == get_area::end(in)) {
+                char digit = traits::to_char_type(c);
+                if (digit < '0' || '9' < digit) {
+                    break;
+                }
+                digits.append(&digit, 1);
+                total++;
+                in->sbumpc();
+            }
+            continue;
+        }
+        char const* run = first;
+        while (run != last && '0' <= *run && *run <= '9') {
+            run++;
+        }
+        digits.append(first, static_cast<size_t>(run - first));
+        total += static_cast<size_t>(run - first);
+        get_area::consume(in, static_cast<size_t>(run - first));
+        if (run != last) {
+            break;
+        }
+    }
+    if (total == 0) {
+        a = 0;
+        s.setstate(std::ios_base::failbit);
+        return s;
+    }
+    while (!a.number.empty()) {
+        a.number.pop_back();
+    }
+    a.number.resize(digits.limbs());
+    size_t size = digits.finish(a.number.data());
+    while (a.number.size() > size) {
+        a.number.pop_back();
+    }
+    a.sign = csign;
+    a.normalize();
+    return s;
+}
+
+size_t std::hash<big_integer>::operator()(big_integer const& a) const noexcept {
+    return static_cast<size_t>(limbs::hash(a.number.data(), a.number.size(), a.sign));
 }
@@ -1,6 +1,7 @@
 #ifndef BIG_INTEGER_H
 #define BIG_INTEGER_H
 
+#include <charconv>
 #include <cstddef>
 #include <iosfwd>
 #include <cstdint>
@@ -8,6 +9,9 @@
 #include <string>
 #include <functional>
 #include <algorithm>
+#include "arena.h"
+#include "fixed_integer.h"
+#include "limbs.h"
 
 struct big_integer {
     using func = std::function<uint32_t(uint32_t, uint32_t)>;
@@ -15,16 +19,32 @@ struct big_integer {
 
     big_integer(big_integer const& other);
 
+    big_integer(big_integer&& other) noexcept;
+
     big_integer(int a);
 
     big_integer(unsigned a);
 
     explicit big_integer(std::string const& str);
 
+    // Parses on up to threads threads, see decimal::from_digits.
+    big_integer(std::string const& str, unsigned threads);
+
+    template<size_t Bits>
+    big_integer(fixed_integer<Bits> const& a) : big_integer() {
+        fixed_integer<Bits> magnitude = a.is_negative() ? -a : a;
+        assign_limbs(magnitude.data(), fixed_integer<Bits>::LIMBS, a.is_negative());
+    }
+
     ~big_integer();
 
     big_integer& operator=(big_integer const& other);
 
+    big_integer& operator=(big_integer&& other) noexcept;
+
+    // Makes room for a magnitude of the given width so that growing up to it does not reallocate.
+    void reserve(size_t bits);
+
     big_integer& operator+=(big_integer const& rhs);
 
     big_integer& operator-=(big_integer const& rhs);
@@ -81,8 +101,24 @@ struct big_integer {
 
     friend std::string to_string(big_integer const& a);
 
+    friend std::string to_string(big_integer const& a, unsigned threads);
+
+    friend std::to_chars_result to_chars(char* first, char* last, big_integer const& a, int base);
+
+    friend size_t max_digits(big_integer const& a, int base);
+
+    friend void add_batch(big_integer const* a, big_integer const* b, big_integer* r, size_t count);
+
+    friend void mul_batch(big_integer const* a, big_integer const* b, big_integer* r, size_t count);
+
     friend int8_t compare(big_integer const& a, big_integer const& b);
 
+    friend std::ostream& operator<<(std::ostream& s, big_integer const& a);
+
+    friend std::istream& operator>>(std::istream& s, big_integer& a);
+
+    friend struct std::hash<big_integer>;
+
     friend big_integer
     bit_operation(big_integer a, big_integer b, const func& func);
 
@@ -94,15 +130,40 @@ private:
 
     void normalize();
 
+    void assign_limbs(uint32_t const* limbs, size_t size, bool negative);
+
+    static const size_t SMALL_LIMBS = 2;
+
+    bool is_small() const;
+
+    uint64_t to_uint64() const;
+
+    void assign_uint128(uint64_t low, uint64_t high, bool negative);
+
+    bool add_small(big_integer const& rhs, bool subtract);
+
+    bool mul_small(big_integer const& rhs);
+
+    // Adds rhs taken with the given sign; rhs may be *this.
+    void add_signed(big_integer const& rhs, bool rhs_negative);
+
+    static int compare_magnitude(big_integer const& a, big_integer const& b);
+
+    // Truncating division of magnitudes: |a| = quotient * |b| + remainder.
+    static void divide(big_integer const& a, big_integer const& b, big_integer& quotient, big_integer& remainder);
+
+    // Limbs [0, width) of the magnitude as one lane of a block laid out for limbs::add_lanes.
+    void store_lane(uint32_t* block, size_t width, size_t lane) const;
+
+    void load_lane(uint32_t const* block, size_t width, size_t lane, bool negative);
+
     uint32_t get_nth(size_t i) const;
 
     void set_nth(size_t i, uint32_t value);
 
-    std::vector<uint32_t> number;
+    std::vector<uint32_t, arena_allocator<uint32_t>> number;
 
     bool sign;
-
-    big_integer div_by_uint(uint32_t b);
 };
 
 
@@ -142,8 +203,39 @@ bool operator>=(big_integer const& a, big_integer const& b);
 
 std::string to_string(big_integer const& a);
 
+// Converts on up to threads threads, see decimal::to_digits.
+std::string to_string(big_integer const& a, unsigned threads);
+
+// Formats a in base 2 to 36 with lowercase letters, like std::to_chars: returns the end of the
+// text, or last and errc::value_too_large if [first, last) is too short. When it holds
+// max_digits(a, base) characters, numbers of up to 14 limbs (134 decimal digits), or of up to
+// 64 limbs in other bases, are formatted without allocating. Bases other than 10 and powers of
+// two take quadratic time.
+std::to_chars_result to_chars(char* first, char* last, big_integer const& a, int base = 10);
+
+// Characters that to_chars may need for a, the sign included.
+size_t max_digits(big_integer const& a, int base = 10);
+
+// r[i] = a[i] + b[i] (a[i] * b[i]) for i < count; r may be a or b. Numbers are transposed
+// BATCH_LANES at a time into struct-of-arrays limbs, so that one AVX2 instruction works on the
+// same limb of eight numbers. Sums are done in two's complement, which covers mixed signs.
+void add_batch(big_integer const* a, big_integer const* b, big_integer* r, size_t count);
+
+void mul_batch(big_integer const* a, big_integer const* b, big_integer* r, size_t count);
+
 std::ostream& operator<<(std::ostream& s, big_integer const& a);
 
+// Reads an optionally signed decimal number after leading whitespace, like the built-in integer
+// extractors. Digits go from the stream buffer to a decimal::accumulator, never into one string.
+std::istream& operator>>(std::istream& s, big_integer& a);
+
 big_integer bit_operation(big_integer a, big_integer b, const std::function<uint32_t(uint32_t, uint32_t)>& func);
 
+// Hashes the sign and the limbs of the magnitude with limbs::hash, so equal numbers hash the
+// same whatever their capacity or storage, in bigint and bigint-optimized alike.
+template<>
+struct std::hash<big_integer> {
+    size_t operator()(big_integer const& a) const noexcept;
+};
+
 #endif // BIG_INTEGER_H
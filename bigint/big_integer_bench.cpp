@@ -0,0 +1,578 @@
+// Operand-size sweep of every big_integer operation against GMP (big_integer_gmp), reporting
+// ns/op and heap allocations/op as CSV or JSON rows. Each tree builds its own binary, named by
+// BIGINT_BENCH_NAME, and one run measures only its own tree and GMP. bigint and bigint-optimized
+// are compared by running both binaries and concatenating their output, e.g.
+//   (bigint/build/big_integer_bench; bigint-optimized/build/big_integer_bench | tail -n +2) > all.csv
+//
+//   big_integer_bench [--format csv|json] [--max-limbs N] [--threads 1,2,4] [--min-time-ms T]
+//                     [--repeats R] [--only add,mul,...]
+//   big_integer_bench --compare bench_baseline.json [--tolerance X] [--min-time-ms T] [--repeats R]
+//
+// Sizes go over powers of four from one limb up to --max-limbs (2^20 by default). Operations
+// that are quadratic here (division, output) stop at QUADRATIC_LIMBS, products and parsing at
+// SUBQUADRATIC_LIMBS, and the unordered_map ones, which hold MAP_KEYS numbers, at KEYED_LIMBS.
+// Each thread count of --threads repeats the operations that can use more than one thread
+// (multiplication and conversion); GMP runs them single-threaded only.
+//
+// --compare reruns the rows of a baseline written with --format json and exits with 1 if any
+// of them got slower, see compare() below. bench_baseline.json next to this file is the one
+// the bench_regression test checks; after an intended slowdown it is regenerated with
+//   big_integer_bench --format json --repeats 9 --min-time-ms 20 --max-limbs 4096
+//                     --only add,mul,div,to_string,from_string > bench_baseline.json
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <new>
+#include <random>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "big_integer.h"
+#include "big_integer_gmp.h"
+
+#ifndef BIGINT_BENCH_NAME
+#define BIGINT_BENCH_NAME "bigint"
+#endif
+
+namespace {
+std::atomic<size_t> allocations(0);
+
+void* gmp_allocate(size_t size) {
+    allocations.fetch_add(1, std::memory_order_relaxed);
+    void* p = std::malloc(size);
+    if (p == nullptr) {
+        std::abort();
+    }
+    return p;
+}
+
+void* gmp_reallocate(void* p, size_t, size_t size) {
+    allocations.fetch_add(1, std::memory_order_relaxed);
+    p = std::realloc(p, size);
+    if (p == nullptr) {
+        std::abort();
+    }
+    return p;
+}
+
+void gmp_free(void* p, size_t) {
+    std::free(p);
+}
+}
+
+// Every heap allocation of big_integer (pool misses included) goes through these.
+void* operator new(size_t size) {
+    allocations.fetch_add(1, std::memory_order_relaxed);
+    if (void* p = std::malloc(size == 0 ? 1 : size)) {
+        return p;
+    }
+    throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept {
+    std::free(p);
+}
+
+void operator delete(void* p, size_t) noexcept {
+    std::free(p);
+}
+
+namespace {
+const size_t QUADRATIC_LIMBS = 4096;
+const size_t SUBQUADRATIC_LIMBS = 65536;
+const size_t KEYED_LIMBS = 4096;
+const size_t MAP_KEYS = 64;
+
+enum class cost {
+    linear,
+    subquadratic,
+    quadratic,
+    keyed,
+};
+
+struct options {
+    bool json = false;
+    size_t max_limbs = static_cast<size_t>(1) << 20;
+    std::vector<unsigned> threads{1};
+    double min_ns = 50e6;
+    unsigned repeats = 1;
+    std::vector<std::string> only;
+    char const* baseline = nullptr;
+    double tolerance = 0.25;
+};
+
+template<typename T>
+struct adapter;
+
+template<>
+struct adapter<big_integer> {
+    static const bool threaded = true;
+
+    static void set_threads(unsigned threads) {
+        limbs::set_mul_threads(threads);
+    }
+
+    static std::string print(big_integer const& a, unsigned threads) {
+        return to_string(a, threads);
+    }
+
+    static big_integer parse(std::string const& str, unsigned threads) {
+        return big_integer(str, threads);
+    }
+};
+
+template<>
+struct adapter<big_integer_gmp> {
+    static const bool threaded = false;
+
+    static void set_threads(unsigned) {}
+
+    static std::string print(big_integer_gmp const& a, unsigned) {
+        return to_string(a);
+    }
+
+    static big_integer_gmp parse(std::string const& str, unsigned) {
+        return big_integer_gmp(str);
+    }
+};
+
+// The same value for every T given the same generator state; halves are joined with a shift,
+// which keeps construction of 2^20-limb operands at O(n log n).
+template<typename T>
+T random_number(size_t limbs, std::mt19937& gen) {
+    if (limbs == 1) {
+        uint32_t limb = static_cast<uint32_t>(gen());
+        return (T(static_cast<int>(limb >> 16)) << 16) + T(static_cast<int>(limb & 0xffff));
+    }
+    size_t low = limbs / 2;
+    T high = random_number<T>(limbs - low, gen);
+    T rest = random_number<T>(low, gen);
+    return (high << static_cast<int>(32 * low)) + rest;
+}
+
+std::string random_digits(size_t limbs, std::mt19937& gen) {
+    // 32 * log10(2) digits per limb.
+    std::string result(limbs * 9633 / 1000 + 1, '0');
+    for (char& digit : result) {
+        digit = static_cast<char>('0' + gen() % 10);
+    }
+    result[0] = '1';
+    return result;
+}
+
+struct measurement {
+    double ns_per_op;
+    double allocs_per_op;
+    size_t iterations;
+};
+
+// Runs f in doubling batches until min_ns have passed, after one warm-up call.
+measurement measure(std::function<void()> const& f, double min_ns) {
+    using clock = std::chrono::steady_clock;
+    f();
+    size_t before = allocations.load(std::memory_order_relaxed);
+    size_t iterations = 0;
+    size_t batch = 1;
+    auto start = clock::now();
+    double elapsed;
+    for (;;) {
+        for (size_t i = 0; i < batch; i++) {
+            f();
+        }
+        iterations += batch;
+        elapsed = std::chrono::duration<double, std::nano>(clock::now() - start).count();
+        if (elapsed >= min_ns) {
+            break;
+        }
+        batch *= 2;
+    }
+    size_t allocated = allocations.load(std::memory_order_relaxed) - before;
+    return {elapsed / iterations, static_cast<double>(allocated) / iterations, iterations};
+}
+
+struct row {
+    std::string implementation;
+    std::string operation;
+    size_t limbs;
+    unsigned threads;
+    double ns_per_op;
+    double allocs_per_op;
+    // (slowest - fastest) / fastest over the repeats; the fastest one is reported.
+    double noise;
+    size_t iterations;
+};
+
+row measure_row(char const* implementation, char const* operation, size_t limbs, unsigned threads,
+                std::function<void()> const& f, options const& opts) {
+    measurement best = measure(f, opts.min_ns);
+    double slowest = best.ns_per_op;
+    for (unsigned i = 1; i < opts.repeats; i++) {
+        measurement m = measure(f, opts.min_ns);
+        slowest = std::max(slowest, m.ns_per_op);
+        if (m.ns_per_op < best.ns_per_op) {
+            best = m;
+        }
+    }
+    return {implementation, operation, limbs, threads, best.ns_per_op, best.allocs_per_op,
+            (slowest - best.ns_per_op) / best.ns_per_op, best.iterations};
+}
+
+struct report {
+    bool json;
+    bool first = true;
+
+    explicit report(bool json) : json(json) {
+        std::printf(json ? "[\n" : "implementation,operation,limbs,threads,ns_per_op,allocs_per_op,noise,iterations\n");
+    }
+
+    ~report() {
+        if (json) {
+            std::printf("\n]\n");
+        }
+    }
+
+    void print(row const& r) {
+        if (json) {
+            std::printf("%s  {\"implementation\": \"%s\", \"operation\": \"%s\", \"limbs\": %zu, \"threads\": %u, "
+                        "\"ns_per_op\": %.2f, \"allocs_per_op\": %.3f, \"noise\": %.3f, \"iterations\": %zu}",
+                        first ? "" : ",\n", r.implementation.c_str(), r.operation.c_str(), r.limbs, r.threads,
+                        r.ns_per_op, r.allocs_per_op, r.noise, r.iterations);
+        } else {
+            std::printf("%s,%s,%zu,%u,%.2f,%.3f,%.3f,%zu\n", r.implementation.c_str(), r.operation.c_str(), r.limbs,
+                        r.threads, r.ns_per_op, r.allocs_per_op, r.noise, r.iterations);
+        }
+        first = false;
+        std::fflush(stdout);
+    }
+};
+
+using wanted_fn = std::function<bool(char const* operation, cost kind, unsigned threads)>;
+
+// Measures the operations on operands of the given size that wanted picks.
+template<typename T>
+void run_size(char const* implementation, size_t limbs, options const& opts, wanted_fn const& wanted,
+              std::function<void(row const&)> const& out) {
+    std::mt19937 gen(static_cast<unsigned>(limbs));
+    T a = random_number<T>(limbs, gen);
+    T b = random_number<T>(limbs, gen);
+    T wide = random_number<T>(2 * limbs, gen);
+    // Equal to a, in storage of its own, so that comparison reads every limb.
+    T twin = (a + 1) - 1;
+    std::string text = random_digits(limbs, gen);
+    T sink;
+    std::string text_sink;
+    bool flag = false;
+    size_t digest = 0;
+    unsigned threads = 1;
+
+    // Keys that differ in the lowest limb only, so that hashing has to read all of them, and
+    // equal probes in storage of their own. map_insert refills the map from empty every
+    // MAP_KEYS insertions; map_find looks the keys up in turn.
+    std::vector<T> keys;
+    std::vector<T> probes;
+    std::unordered_map<T, int> map;
+    std::unordered_map<T, int> filled;
+    size_t next = 0;
+    if (limbs <= KEYED_LIMBS) {
+        for (size_t i = 0; i < MAP_KEYS; i++) {
+            keys.push_back(a + T(static_cast<int>(i)));
+            probes.push_back((keys.back() + 1) - 1);
+            filled.emplace(keys.back(), static_cast<int>(i));
+        }
+    }
+
+    struct operation {
+        char const* name;
+        cost kind;
+        bool threaded;
+        std::function<void()> run;
+    };
+    std::vector<operation> operations = {
+        {"copy", cost::linear, false, [&] { sink = a; }},
+        {"add", cost::linear, false, [&] { sink = a + b; }},
+        {"sub", cost::linear, false, [&] { sink = a - b; }},
+        {"mul", cost::subquadratic, true, [&] { sink = a * b; }},
+        {"div", cost::quadratic, false, [&] { sink = wide / b; }},
+        {"mod", cost::quadratic, false, [&] { sink = wide % b; }},
+        {"and", cost::linear, false, [&] { sink = a & b; }},
+        {"or", cost::linear, false, [&] { sink = a | b; }},
+        {"xor", cost::linear, false, [&] { sink = a ^ b; }},
+        {"shl", cost::linear, false, [&] { sink = a << 37; }},
+        {"shr", cost::linear, false, [&] { sink = a >> 37; }},
+        {"neg", cost::linear, false, [&] { sink = -a; }},
+        {"cmp", cost::linear, false, [&] { flag ^= a < twin; }},
+        {"to_string", cost::quadratic, true, [&] { text_sink = adapter<T>::print(a, threads); }},
+        {"from_string", cost::subquadratic, true, [&] { sink = adapter<T>::parse(text, threads); }},
+        {"hash", cost::linear, false, [&] { digest ^= std::hash<T>()(a); }},
+        {"map_insert", cost::keyed, false, [&] {
+            if (map.size() == MAP_KEYS) {
+                map.clear();
+            }
+            map.emplace(keys[next++ % MAP_KEYS], 0);
+        }},
+        {"map_find", cost::keyed, false, [&] { digest += filled.find(probes[next++ % MAP_KEYS])->second; }},
+    };
+    for (operation const& op : operations) {
+        for (unsigned t : opts.threads) {
+            if ((t > 1 && !(op.threaded && adapter<T>::threaded)) || !wanted(op.name, op.kind, t)) {
+                continue;
+            }
+            threads = t;
+            adapter<T>::set_threads(t);
+            out(measure_row(implementation, op.name, limbs, t, op.run, opts));
+        }
+        adapter<T>::set_threads(1);
+    }
+    static_cast<void>(flag);
+    static_cast<void>(digest);
+}
+
+bool selected(options const& opts, char const* operation) {
+    if (opts.only.empty()) {
+        return true;
+    }
+    for (std::string const& name : opts.only) {
+        if (name == operation) {
+            return true;
+        }
+    }
+    return false;
+}
+
+template<typename T>
+void sweep(char const* implementation, options const& opts, report& out) {
+    for (size_t limbs = 1; limbs <= opts.max_limbs; limbs *= 4) {
+        run_size<T>(implementation, limbs, opts, [&](char const* operation, cost kind, unsigned) {
+            size_t cap = kind == cost::quadratic ? QUADRATIC_LIMBS
+                         : kind == cost::subquadratic ? SUBQUADRATIC_LIMBS
+                         : kind == cost::keyed ? KEYED_LIMBS : opts.max_limbs;
+            return limbs <= cap && selected(opts, operation);
+        }, [&](row const& r) { out.print(r); });
+    }
+}
+
+// Value of "key" in one line of the JSON that report writes, without quotes.
+std::string field(std::string const& line, char const* key) {
+    std::string pattern = std::string("\"") + key + "\": ";
+    size_t begin = line.find(pattern);
+    if (begin == std::string::npos) {
+        return "";
+    }
+    begin += pattern.size();
+    size_t end = line.find_first_of(",}", begin);
+    std::string value = line.substr(begin, end == std::string::npos ? std::string::npos : end - begin);
+    if (value.size() >= 2 && value.front() == '"' && value.back() == '"') {
+        value = value.substr(1, value.size() - 2);
+    }
+    return value;
+}
+
+bool read_baseline(char const* path, std::vector<row>& rows) {
+    std::FILE* file = std::fopen(path, "r");
+    if (file == nullptr) {
+        return false;
+    }
+    std::string line;
+    for (int c = std::fgetc(file);; c = std::fgetc(file)) {
+        if (c != '\n' && c != EOF) {
+            line += static_cast<char>(c);
+            continue;
+        }
+        if (line.find("\"operation\"") != std::string::npos) {
+            rows.push_back({field(line, "implementation"), field(line, "operation"),
+                            std::strtoull(field(line, "limbs").c_str(), nullptr, 10),
+                            static_cast<unsigned>(std::strtoul(field(line, "threads").c_str(), nullptr, 10)),
+                            std::strtod(field(line, "ns_per_op").c_str(), nullptr),
+                            std::strtod(field(line, "allocs_per_op").c_str(), nullptr),
+                            std::strtod(field(line, "noise").c_str(), nullptr), 0});
+        }
+        line.clear();
+        if (c == EOF) {
+            break;
+        }
+    }
+    std::fclose(file);
+    return !rows.empty();
+}
+
+bool same_key(row const& a, row const& b) {
+    return a.implementation == b.implementation && a.operation == b.operation && a.limbs == b.limbs &&
+           a.threads == b.threads;
+}
+
+row const* find(std::vector<row> const& rows, row const& key) {
+    for (row const& r : rows) {
+        if (same_key(r, key)) {
+            return &r;
+        }
+    }
+    return nullptr;
+}
+
+template<typename T>
+void rerun(char const* implementation, std::vector<row> const& baseline, options const& opts, std::vector<row>& current) {
+    std::vector<size_t> sizes;
+    for (row const& r : baseline) {
+        if (r.implementation == implementation && std::find(sizes.begin(), sizes.end(), r.limbs) == sizes.end()) {
+            sizes.push_back(r.limbs);
+        }
+    }
+    for (size_t limbs : sizes) {
+        run_size<T>(implementation, limbs, opts, [&](char const* operation, cost, unsigned threads) {
+            return find(baseline, {implementation, operation, limbs, threads, 0, 0, 0, 0}) != nullptr;
+        }, [&](row const& r) { current.push_back(r); });
+    }
+}
+
+// Most that the noise of a row may widen its limit by, so that a noisy row still catches a
+// real slowdown.
+const double MAX_NOISE = 0.1;
+
+const unsigned RETRIES = 3;
+
+// Reruns every row of the baseline for this tree and for GMP. GMP does not change with our code,
+// so the geometric mean of its current/baseline ratios is taken as the speed of this machine
+// relative to the one that recorded the baseline, and divided out of our ratios. A row regresses
+// when its ratio exceeds 1 + tolerance plus twice the larger noise of the two measurements (at
+// most MAX_NOISE), and still does when measured again RETRIES times.
+int compare(char const* path, options const& opts) {
+    std::vector<row> baseline;
+    if (!read_baseline(path, baseline)) {
+        std::fprintf(stderr, "cannot read baseline %s\n", path);
+        return 2;
+    }
+    std::vector<row> current;
+    rerun<big_integer>(BIGINT_BENCH_NAME, baseline, opts, current);
+    rerun<big_integer_gmp>("gmp", baseline, opts, current);
+
+    double log_sum = 0;
+    size_t calibration_rows = 0;
+    for (row const& r : current) {
+        if (r.implementation == "gmp") {
+            log_sum += std::log(r.ns_per_op / find(baseline, r)->ns_per_op);
+            calibration_rows++;
+        }
+    }
+    double machine = calibration_rows == 0 ? 1 : std::exp(log_sum / calibration_rows);
+    auto ratio = [&](row const& r) {
+        return r.ns_per_op / (find(baseline, r)->ns_per_op * machine);
+    };
+    auto limit = [&](row const& r) {
+        return 1 + opts.tolerance + 2 * std::min(std::max(find(baseline, r)->noise, r.noise), MAX_NOISE);
+    };
+
+    // A slow row is measured up to RETRIES more times before it counts, which filters out stalls
+    // of a shared machine that outlast a single retry.
+    for (unsigned retry = 0; retry < RETRIES; retry++) {
+        std::vector<row> suspects;
+        for (row const& r : current) {
+            if (r.implementation != "gmp" && ratio(r) > limit(r)) {
+                suspects.push_back(r);
+            }
+        }
+        std::vector<row> retried;
+        rerun<big_integer>(BIGINT_BENCH_NAME, suspects, opts, retried);
+        for (row const& r : retried) {
+            row& first = *std::find_if(current.begin(), current.end(),
+                                       [&](row const& c) { return same_key(c, r); });
+            if (r.ns_per_op < first.ns_per_op) {
+                first = r;
+            }
+        }
+    }
+
+    std::printf("%-12s %8s %7s %14s %14s %7s %7s\n", "operation", "limbs", "threads", "baseline ns",
+                "current ns", "ratio", "limit");
+    size_t compared = 0;
+    size_t regressed = 0;
+    for (row const& r : current) {
+        if (r.implementation == "gmp") {
+            continue;
+        }
+        bool slower = ratio(r) > limit(r);
+        compared++;
+        regressed += slower;
+        std::printf("%-12s %8zu %7u %14.1f %14.1f %7.2f %7.2f%s\n", r.operation.c_str(), r.limbs, r.threads,
+                    find(baseline, r)->ns_per_op, r.ns_per_op, ratio(r), limit(r), slower ? "  REGRESSED" : "");
+    }
+    std::printf("%s: %zu of %zu operations regressed; machine factor %.2f from %zu gmp rows\n",
+                BIGINT_BENCH_NAME, regressed, compared, machine, calibration_rows);
+    if (compared == 0) {
+        std::fprintf(stderr, "baseline %s has no rows for %s\n", path, BIGINT_BENCH_NAME);
+        return 2;
+    }
+    return regressed == 0 ? 0 : 1;
+}
+
+std::vector<std::string> split(char const* list) {
+    std::vector<std::string> result;
+    std::string current;
+    for (char const* c = list;; c++) {
+        if (*c == ',' || *c == '\0') {
+            if (!current.empty()) {
+                result.push_back(current);
+            }
+            current.clear();
+            if (*c == '\0') {
+                return result;
+            }
+        } else {
+            current += *c;
+        }
+    }
+}
+
+bool parse_options(int argc, char** argv, options& opts) {
+    for (int i = 1; i < argc; i++) {
+        bool has_value = i + 1 < argc;
+        if (std::strcmp(argv[i], "--format") == 0 && has_value) {
+            opts.json = std::strcmp(argv[++i], "json") == 0;
+        } else if (std::strcmp(argv[i], "--max-limbs") == 0 && has_value) {
+            opts.max_limbs = std::strtoull(argv[++i], nullptr, 10);
+        } else if (std::strcmp(argv[i], "--threads") == 0 && has_value) {
+            opts.threads.clear();
+            for (std::string const& count : split(argv[++i])) {
+                opts.threads.push_back(static_cast<unsigned>(std::max(1ul, std::strtoul(count.c_str(), nullptr, 10))));
+            }
+        } else if (std::strcmp(argv[i], "--min-time-ms") == 0 && has_value) {
+            opts.min_ns = std::strtod(argv[++i], nullptr) * 1e6;
+        } else if (std::strcmp(argv[i], "--repeats") == 0 && has_value) {
+            opts.repeats = static_cast<unsigned>(std::max(1ul, std::strtoul(argv[++i], nullptr, 10)));
+        } else if (std::strcmp(argv[i], "--only") == 0 && has_value) {
+            opts.only = split(argv[++i]);
+        } else if (std::strcmp(argv[i], "--compare") == 0 && has_value) {
+            opts.baseline = argv[++i];
+        } else if (std::strcmp(argv[i], "--tolerance") == 0 && has_value) {
+            opts.tolerance = std::strtod(argv[++i], nullptr);
+        } else {
+            return false;
+        }
+    }
+    return !opts.threads.empty();
+}
+}
+
+int main(int argc, char** argv) {
+    options opts;
+    if (!parse_options(argc, argv, opts)) {
+        std::fprintf(stderr, "usage: %s [--format csv|json] [--max-limbs N] [--threads 1,2,4] [--min-time-ms T]\n"
+                             "       [--repeats R] [--only add,mul,...] [--compare baseline.json [--tolerance X]]\n",
+                     argv[0]);
+        return 2;
+    }
+    mp_set_memory_functions(gmp_allocate, gmp_reallocate, gmp_free);
+    if (opts.baseline != nullptr) {
+        return compare(opts.baseline, opts);
+    }
+    report out(opts.json);
+    sweep<big_integer>(BIGINT_BENCH_NAME, opts, out);
+    sweep<big_integer_gmp>("gmp", opts, out);
+    return 0;
+}
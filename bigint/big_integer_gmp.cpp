@@ -2,6 +2,7 @@
 
 #include <cstring>
 #include <stdexcept>
+#include <string_view>
 
 big_integer_gmp::big_integer_gmp() {
   mpz_init(mpz);
@@ -197,4 +198,11 @@ std::string to_string(big_integer_gmp const& a) {
 
 std::ostream& operator<<(std::ostream& s, big_integer_gmp const& a) {
   return s << to_string(a);
-}
\ No newline at end of file
+}
+
+size_t std::hash<big_integer_gmp>::operator()(big_integer_gmp const& a) const noexcept {
+  std::string_view bytes(reinterpret_cast<char const*>(mpz_limbs_read(a.mpz)),
+                         mpz_size(a.mpz) * sizeof(mp_limb_t));
+  size_t h = std::hash<std::string_view>()(bytes);
+  return mpz_sgn(a.mpz) < 0 ? ~h : h;
+}
@@ -1,13 +1,52 @@
 #include <algorithm>
 #include <cassert>
 #include <cstdlib>
+#include <iomanip>
 #include <random>
+#include <sstream>
 #include <vector>
 #include <utility>
+#include <memory>
+#include <new>
+#include <numeric>
+#include <thread>
+#include <unordered_map>
 #include <gtest/gtest.h>
 
 #include "big_integer.h"
 #include "big_integer_gmp.h"
+#include "decimal.h"
+#include "fixed_integer.h"
+#include "instrumentation.h"
+
+// Every global allocation of the thread is counted, so that tests can assert that an operation
+// does not allocate. Kept out of line: once inlined, GCC pairs new expressions with the free
+// inside and reports a mismatch.
+static thread_local size_t allocations = 0;
+
+__attribute__((noinline)) void* operator new(size_t size) {
+  allocations++;
+  if (void* p = std::malloc(size == 0 ? 1 : size)) {
+    return p;
+  }
+  throw std::bad_alloc();
+}
+
+__attribute__((noinline)) void operator delete(void* p) noexcept {
+  std::free(p);
+}
+
+__attribute__((noinline)) void operator delete(void* p, size_t) noexcept {
+  std::free(p);
+}
+
+// Allocations made by f on this thread.
+template<typename F>
+size_t allocations_during(F f) {
+  size_t before = allocations;
+  f();
+  return allocations - before;
+}
 
 TEST(correctness, two_plus_two) {
   EXPECT_EQ(big_integer(4), big_integer(2) + big_integer(2));
@@ -815,3 +854,730 @@ TEST(correctness_twos_complement, all_ones) {
 
   EXPECT_EQ(to_string(gmp_ans), to_string(your_ans));
 }
+
+TEST(fixed_integer, two_plus_two) {
+  EXPECT_EQ(fixed_integer<64>(4), fixed_integer<64>(2) + fixed_integer<64>(2));
+  EXPECT_EQ(4, fixed_integer<64>(2) + 2);
+  EXPECT_EQ(4, 2 + fixed_integer<64>(2));
+}
+
+TEST(fixed_integer, wraparound) {
+  fixed_integer<64> max("9223372036854775807");
+  fixed_integer<64> min("-9223372036854775808");
+  EXPECT_EQ(min, max + 1);
+  EXPECT_EQ(max, min - 1);
+  EXPECT_EQ(min, -min);
+  EXPECT_EQ(0, max * 2 + 2);
+  EXPECT_EQ("-9223372036854775808", to_string(min));
+}
+
+TEST(fixed_integer, shifts_and_bits) {
+  fixed_integer<128> a(-1);
+  EXPECT_EQ(-1, a >> 100);
+  EXPECT_EQ(-4, a << 2);
+  EXPECT_EQ(fixed_integer<128>("-1267650600228229401496703205376"), a << 100);
+  EXPECT_EQ(0, a << 128);
+  EXPECT_EQ(-3, fixed_integer<128>(-5) >> 1);
+  EXPECT_EQ(0, fixed_integer<128>(5) & -6);
+  EXPECT_EQ(-1, fixed_integer<128>(5) | -6);
+  EXPECT_EQ(-2, ~fixed_integer<128>(1));
+}
+
+TEST(fixed_integer, random_vs_gmp) {
+  std::default_random_engine rng(42);
+  for (size_t itn = 0; itn != 100 * number_of_iterations; ++itn) {
+    big_integer_gmp a, b;
+    a.random(250, rng);
+    b.random(itn % 250 + 1, rng);
+    if (b == 0) {
+      continue;
+    }
+    fixed_integer<512> A(to_string(a)), B(to_string(b));
+    EXPECT_EQ(to_string(a + b), to_string(A + B));
+    EXPECT_EQ(to_string(a - b), to_string(A - B));
+    EXPECT_EQ(to_string(a * b), to_string(A * B));
+    EXPECT_EQ(to_string(a / b), to_string(A / B));
+    EXPECT_EQ(to_string(a % b), to_string(A % B));
+    EXPECT_EQ(to_string(a & b), to_string(A & B));
+    EXPECT_EQ(to_string(a | b), to_string(A | B));
+    EXPECT_EQ(to_string(a ^ b), to_string(A ^ B));
+    EXPECT_EQ(a < b, A < B);
+    EXPECT_EQ(a == b, A == B);
+  }
+}
+
+namespace {
+constexpr auto mersenne_127 = 170141183460469231731687303715884105727_bi;
+static_assert(mersenne_127 == (fixed_integer<160>(1) << 127) - 1, "literal is evaluated at compile time");
+static_assert(1'000'000'007_bi * fixed_integer<64>(3_bi) == 3'000'000'021_bi, "");
+static_assert(-(12_bi * 12_bi) / 5_bi == -28, "");
+// Overflow of a constant expression does not compile, so results that need more room are widened.
+static_assert(fixed_integer<64>(1000000_bi) * fixed_integer<64>(1000000_bi) == 1'000'000'000'000_bi, "");
+static_assert(fixed_integer<32>(-65536) * 32768 == fixed_integer<32>(1) << 31, "the most negative value fits");
+}
+
+TEST(fixed_integer, literals) {
+  big_integer a = mersenne_127;
+  EXPECT_EQ(big_integer("170141183460469231731687303715884105727"), a);
+  big_integer b = -mersenne_127;
+  EXPECT_EQ(big_integer("-170141183460469231731687303715884105727"), b);
+  EXPECT_EQ(0, big_integer(0_bi));
+  EXPECT_EQ(big_integer("-4294967296"), -4294967296_bi);
+  EXPECT_EQ(big_integer(2), fixed_integer<96>(2_bi));
+}
+
+TEST(correctness, small_operands_boundaries) {
+  std::vector<std::string> values = {"0", "1", "-1", "4294967295", "-4294967296", "4294967296",
+                                     "18446744073709551615", "-18446744073709551615",
+                                     "9223372036854775808", "-12345678901234567"};
+  for (auto const& x : values) {
+    for (auto const& y : values) {
+      big_integer a(x), b(y);
+      big_integer_gmp ga(x), gb(y);
+      EXPECT_EQ(to_string(ga + gb), to_string(a + b));
+      EXPECT_EQ(to_string(ga - gb), to_string(a - b));
+      EXPECT_EQ(to_string(ga * gb), to_string(a * b));
+      EXPECT_EQ(ga < gb, a < b);
+      EXPECT_EQ(ga == gb, a == b);
+      if (gb != 0) {
+        EXPECT_EQ(to_string(ga / gb), to_string(a / b));
+        EXPECT_EQ(to_string(ga % gb), to_string(a % b));
+      }
+    }
+  }
+}
+
+TEST(arena, scratch_comes_from_arena) {
+  big_integer outside("123456789012345678901234567890");
+  std::unique_ptr<big_integer> heap_value(new big_integer(outside * outside));
+  big_integer result;
+  {
+    scoped_arena arena;
+    big_integer t = outside;
+    for (int i = 0; i < 10; i++) {
+      t *= outside;
+      t += i;
+    }
+    heap_value.reset();
+    result = t / (outside + 1);
+    // Scratch freed in reverse order of allocation gives all of it back.
+    EXPECT_EQ(0u, arena.used());
+    EXPECT_GT(arena.reserved(), 0u);
+    {
+      scoped_arena nested(128);
+      big_integer u = t * t;
+      EXPECT_EQ(t, u / t);
+      EXPECT_GT(nested.reserved(), 0u);
+    }
+    {
+      size_t reserved = arena.reserved();
+      arena_pause pause;
+      EXPECT_EQ(t, t * outside / outside);
+      EXPECT_EQ(reserved, arena.reserved());
+    }
+  }
+  big_integer expected = outside;
+  for (int i = 0; i < 10; i++) {
+    expected *= outside;
+    expected += i;
+  }
+  EXPECT_EQ(expected / (outside + 1), result);
+}
+
+TEST(arena, numbers_outlive_the_scope) {
+  big_integer a = (big_integer(1) << 3000) - 12345;
+  big_integer b = (big_integer(1) << 1000) + 1;
+  big_integer x = a;
+  big_integer y;
+  std::vector<big_integer> moved;
+  auto make = [&] {
+    scoped_arena arena;
+    big_integer r = a * a;
+    r /= b;
+    return r;
+  };
+  big_integer returned = make();
+  {
+    scoped_arena arena;
+    x *= x;
+    x /= b;
+    moved.push_back(a * a / b);
+    moved.push_back(std::move(x) + 0);
+    y = a * a / b;
+    EXPECT_GT(arena.reserved(), 0u);
+  }
+  // Reuses memory the arena gave back.
+  std::vector<big_integer> scribble(100, (big_integer(1) << 3000) - 1);
+  big_integer expected = a * a / b;
+  EXPECT_EQ(expected, moved[0]);
+  EXPECT_EQ(expected, moved[1]);
+  EXPECT_EQ(expected, y);
+  EXPECT_EQ(expected, returned);
+}
+
+TEST(arena, numbers_move_to_another_thread) {
+  big_integer expected = (big_integer(1) << 300) + 7;
+  big_integer copied;
+  {
+    scoped_arena arena;
+    big_integer t = expected * 3 / 3;
+    std::thread worker([&copied, moved = std::move(t)] { copied = moved; });
+    worker.join();
+  }
+  std::vector<big_integer> scribble(100, (big_integer(1) << 300) - 1);
+  EXPECT_EQ(expected, copied);
+}
+
+TEST(correctness, div_by_all_ones_top_limb) {
+  big_integer a = (big_integer(1) << 200) + 12345;
+  big_integer b = (big_integer(1) << 96) - 1;
+  EXPECT_EQ(big_integer("20282409603651670423947251286272"), a / b);
+  EXPECT_EQ(a, a / b * b + a % b);
+}
+
+TEST(correctness, reserve_keeps_value) {
+  big_integer a = -12345;
+  a.reserve(4096);
+  EXPECT_EQ(-12345, a);
+  big_integer b = a;
+  b.reserve(1);
+  for (int i = 0; i < 100; i++) {
+    a *= 1000000007;
+  }
+  EXPECT_EQ(-12345, b);
+  EXPECT_EQ(big_integer(0), a % 1000000007);
+}
+
+TEST(correctness, shr_negative_exact) {
+  EXPECT_EQ(-2, big_integer(-4) >> 1);
+  EXPECT_EQ(-3, big_integer(-5) >> 1);
+  EXPECT_EQ(-(big_integer(1) << 70), -(big_integer(1) << 100) >> 30);
+  EXPECT_EQ(-(big_integer(1) << 70) - 1, (-(big_integer(1) << 100) - 1) >> 30);
+  EXPECT_EQ(-1, -(big_integer(1) << 100) >> 101);
+}
+
+TEST(limbs, divrem_inverts_mul) {
+  std::mt19937 gen(7);
+  for (size_t n = 2; n < 12; n++) {
+    for (size_t m = n + 1; m < 20; m++) {
+      std::vector<uint32_t> u(m), v(n), q(m - n + 1), product(m + 1);
+      for (uint32_t& limb : u) limb = gen();
+      for (uint32_t& limb : v) limb = gen();
+      v[n - 1] |= 0x80000000u;
+      u.push_back(0);
+      while (u[m] >= v[n - 1]) u[m] = gen();
+      std::vector<uint32_t> remainder = u;
+      limbs::divrem(q.data(), remainder.data(), m + 1, v.data(), n);
+      ASSERT_LT(limbs::cmp(remainder.data(), v.data(), n), 0);
+      limbs::mul(product.data(), q.data(), q.size(), v.data(), n);
+      uint32_t carry = limbs::add_n(product.data(), product.data(), remainder.data(), n);
+      EXPECT_EQ(0u, limbs::add_1(product.data() + n, product.data() + n, m + 1 - n, carry));
+      EXPECT_EQ(0, limbs::cmp(product.data(), u.data(), m + 1));
+    }
+  }
+}
+
+TEST(limbs, kernels_match_reference) {
+  limbs::kernel_set initial = limbs::active_kernels();
+  for (limbs::kernel_set set : {limbs::kernel_set::generic, limbs::kernel_set::x86_64, limbs::kernel_set::adx}) {
+    if (!limbs::use_kernels(set)) {
+      continue;
+    }
+    SCOPED_TRACE(limbs::kernel_set_name(set));
+    std::mt19937 gen(11);
+    for (size_t n = 0; n < 10; n++) {
+      for (int round = 0; round < 20; round++) {
+        std::vector<uint32_t> a(n), b(n), r(n);
+        for (size_t i = 0; i < n; i++) {
+          a[i] = round % 2 ? UINT32_MAX - gen() % 2 : gen();
+          b[i] = round % 3 ? UINT32_MAX - gen() % 2 : gen();
+        }
+        uint32_t multiplier = round % 4 ? UINT32_MAX : gen();
+
+        uint64_t carry = 0;
+        std::vector<uint32_t> expected(n);
+        for (size_t i = 0; i < n; i++) {
+          uint64_t sum = static_cast<uint64_t>(a[i]) + b[i] + carry;
+          expected[i] = static_cast<uint32_t>(sum);
+          carry = sum >> 32u;
+        }
+        EXPECT_EQ(carry, limbs::add_n(r.data(), a.data(), b.data(), n));
+        EXPECT_EQ(expected, r);
+
+        uint64_t borrow = 0;
+        for (size_t i = 0; i < n; i++) {
+          uint64_t diff = static_cast<uint64_t>(a[i]) - b[i] - borrow;
+          expected[i] = static_cast<uint32_t>(diff);
+          borrow = diff >> 63u;
+        }
+        EXPECT_EQ(borrow, limbs::sub_n(r.data(), a.data(), b.data(), n));
+        EXPECT_EQ(expected, r);
+
+        carry = 0;
+        for (size_t i = 0; i < n; i++) {
+          uint64_t product = static_cast<uint64_t>(a[i]) * multiplier + b[i] + carry;
+          expected[i] = static_cast<uint32_t>(product);
+          carry = product >> 32u;
+        }
+        r = b;
+        EXPECT_EQ(carry, limbs::addmul_1(r.data(), a.data(), n, multiplier));
+        EXPECT_EQ(expected, r);
+      }
+    }
+
+    big_integer a = (big_integer(1) << 1000) - 1;
+    EXPECT_EQ((big_integer(1) << 2000) - (big_integer(1) << 1001) + 1, a * a);
+  }
+  limbs::use_kernels(initial);
+}
+
+TEST(limbs, radix52_matches_schoolbook) {
+  std::mt19937 gen(13);
+  bool initial = limbs::ifma_enabled();
+  limbs::use_ifma(false);
+  for (size_t n : {1, 5, 32, 77, 256}) {
+    for (size_t m : {1, 3, 32, 100, 256}) {
+      std::vector<uint32_t> a(n, UINT32_MAX), b(m, UINT32_MAX), expected(n + m), r(n + m);
+      if (n % 2) {
+        for (uint32_t& limb : a) limb = gen();
+      }
+      limbs::mul_basecase(expected.data(), a.data(), n, b.data(), m);
+      limbs::mul_radix52(r.data(), a.data(), n, b.data(), m, false);
+      EXPECT_EQ(expected, r);
+      if (limbs::ifma_supported()) {
+        std::fill(r.begin(), r.end(), 0);
+        limbs::mul_radix52(r.data(), a.data(), n, b.data(), m, true);
+        EXPECT_EQ(expected, r);
+      }
+    }
+  }
+  limbs::use_ifma(initial);
+  big_integer a = (big_integer(1) << 4000) - 1;
+  EXPECT_EQ((big_integer(1) << 8000) - (big_integer(1) << 4001) + 1, a * a);
+}
+
+TEST(limbs, karatsuba_matches_schoolbook) {
+  std::mt19937 gen(17);
+  bool initial = limbs::ifma_enabled();
+  unsigned threads = limbs::mul_threads();
+  for (bool ifma : {false, true}) {
+    limbs::use_ifma(ifma);
+    for (size_t n : {48, 97, 300, 1000, 2500}) {
+      for (size_t m : {1, 47, 49, 160, 999, 2500}) {
+        std::vector<uint32_t> a(n, UINT32_MAX), b(m, UINT32_MAX), expected(n + m), r(n + m);
+        if (m % 2) {
+          for (uint32_t& limb : a) limb = gen();
+          for (uint32_t& limb : b) limb = gen();
+        }
+        limbs::mul_basecase(expected.data(), a.data(), n, b.data(), m);
+        for (unsigned t : {1, 2, 4}) {
+          limbs::set_mul_threads(t);
+          std::fill(r.begin(), r.end(), 0);
+          limbs::mul(r.data(), b.data(), m, a.data(), n);
+          EXPECT_EQ(expected, r);
+        }
+      }
+    }
+  }
+  limbs::use_ifma(initial);
+  limbs::set_mul_threads(threads);
+}
+
+TEST(correctness, to_string_chunk_boundaries) {
+  std::string nines;
+  for (size_t length = 1; length < 60; length++) {
+    nines += '9';
+    EXPECT_EQ(nines, to_string(big_integer(nines)));
+    EXPECT_EQ("1" + std::string(length, '0'), to_string(big_integer(nines) + 1));
+    EXPECT_EQ("-1" + std::string(length - 1, '0') + "7", to_string(-(big_integer(nines) + 1) - 7));
+  }
+  EXPECT_EQ("1000000000000000001000000000", to_string(big_integer("1000000000000000001000000000")));
+}
+
+TEST(correctness, threaded_conversion) {
+  std::mt19937 gen(19);
+  for (size_t length : {1, 9, 143, 144, 145, 1000, 40000}) {
+    std::string digits(length, '0');
+    for (char& digit : digits) digit = static_cast<char>('0' + gen() % 10);
+    digits[0] = '7';
+    std::string expected = to_string(big_integer_gmp("-" + digits));
+    for (unsigned threads : {1, 4}) {
+      big_integer a("-" + digits, threads);
+      EXPECT_EQ(expected, to_string(a, threads));
+      EXPECT_EQ(a, big_integer(expected));
+    }
+  }
+  big_integer power = 1;
+  for (size_t i = 0; i < 4000; i++) power *= 1000000000;
+  std::string text = "1" + std::string(36000, '0');
+  EXPECT_EQ(text, to_string(power, 4));
+  EXPECT_EQ(power, big_integer(text, 4));
+  EXPECT_EQ(power - 1, big_integer(std::string(36000, '9'), 4));
+  EXPECT_EQ(0, big_integer("-000", 4));
+}
+
+TEST(limbs, batch_lanes_match_scalar) {
+  std::mt19937 gen(23);
+  const size_t lanes = limbs::BATCH_LANES;
+  for (size_t n : {1, 4, 16}) {
+    for (size_t m : {1, 5, 16}) {
+      std::vector<uint32_t> a(n * lanes), b(m * lanes), sum((n + 1) * lanes), product((n + m) * lanes);
+      for (size_t i = 0; i < a.size(); i++) a[i] = i % lanes == 0 ? UINT32_MAX : static_cast<uint32_t>(gen());
+      for (size_t i = 0; i < b.size(); i++) b[i] = i % lanes == 0 ? UINT32_MAX : static_cast<uint32_t>(gen());
+      for (bool avx2 : {false, true}) {
+        if (avx2 && !limbs::avx2_supported()) {
+          continue;
+        }
+        limbs::mul_lanes(product.data(), a.data(), n, b.data(), m, avx2);
+        if (n == m) {
+          limbs::add_lanes(sum.data(), a.data(), b.data(), n, avx2);
+        }
+        for (size_t lane = 0; lane < lanes; lane++) {
+          std::vector<uint32_t> x(n), y(m), expected(n + m), actual(n + m);
+          for (size_t i = 0; i < n; i++) x[i] = a[i * lanes + lane];
+          for (size_t i = 0; i < m; i++) y[i] = b[i * lanes + lane];
+          limbs::mul_basecase(expected.data(), x.data(), n, y.data(), m);
+          for (size_t i = 0; i < n + m; i++) actual[i] = product[i * lanes + lane];
+          EXPECT_EQ(expected, actual);
+          if (n == m) {
+            expected.resize(n + 1);
+            expected[n] = limbs::add_n(expected.data(), x.data(), y.data(), n);
+            actual.resize(n + 1);
+            for (size_t i = 0; i <= n; i++) actual[i] = sum[i * lanes + lane];
+            EXPECT_EQ(expected, actual);
+          }
+        }
+      }
+    }
+  }
+}
+
+TEST(correctness, batch_matches_operators) {
+  std::mt19937 gen(29);
+  std::vector<big_integer> a, b;
+  for (size_t i = 0; i < 21; i++) {
+    for (std::vector<big_integer>* numbers : {&a, &b}) {
+      big_integer x;
+      for (size_t length = gen() % 17; length > 0; length--) {
+        x = (x << 32) + (i % 5 == 0 ? UINT32_MAX : static_cast<unsigned>(gen()));
+      }
+      numbers->push_back(gen() % 2 ? -x : x);
+    }
+  }
+  std::vector<big_integer> sums(a.size()), products(a.size());
+  add_batch(a.data(), b.data(), sums.data(), a.size());
+  mul_batch(a.data(), b.data(), products.data(), a.size());
+  for (size_t i = 0; i < a.size(); i++) {
+    EXPECT_EQ(a[i] + b[i], sums[i]);
+    EXPECT_EQ(a[i] * b[i], products[i]);
+  }
+  add_batch(a.data(), b.data(), a.data(), a.size());
+  EXPECT_EQ(sums, a);
+}
+
+TEST(instrumentation, counts_outermost_operator) {
+  big_integer a = (big_integer(1) << 120) + 7;
+  instrumentation::reset();
+  big_integer b = a * a;
+  EXPECT_EQ(to_string(b), to_string(b));
+  instrumentation::stats mul = instrumentation::snapshot(instrumentation::op::mul);
+  instrumentation::stats printed = instrumentation::snapshot(instrumentation::op::to_string);
+  std::string json = instrumentation::to_json();
+  EXPECT_NE(json.find("\"name\": \"mul\""), std::string::npos);
+  if (!instrumentation::enabled()) {
+    EXPECT_EQ(0u, mul.calls);
+    EXPECT_EQ(0u, mul.allocations);
+    return;
+  }
+  // operator* runs operator*= inside, which is not counted again.
+  EXPECT_EQ(1u, mul.calls);
+  EXPECT_EQ(8u, mul.limbs);
+  EXPECT_GE(mul.allocations, 1u);
+  // 8 limbs fall in size bucket [8, 16).
+  EXPECT_EQ(1u, std::accumulate(mul.latency[4], mul.latency[4] + instrumentation::LATENCY_BUCKETS, uint64_t(0)));
+  EXPECT_EQ(2u, printed.calls);
+  EXPECT_NE(json.find("\"calls\": 2"), std::string::npos);
+}
+
+TEST(allocations, in_place_operators_within_capacity) {
+  big_integer a = (big_integer(1) << 200) + 12345;
+  big_integer b = (big_integer(1) << 100) - 1;
+  big_integer one = 1;
+  big_integer expected = a;
+  a.reserve(320);
+  EXPECT_EQ(0u, allocations_during([&] {
+    a += b;
+    a -= b;
+    a += one;
+    a -= one;
+    a -= b;
+    a += b;
+    a <<= 40;
+    a >>= 40;
+  }));
+  EXPECT_EQ(expected, a);
+}
+
+TEST(allocations, small_in_place_operators) {
+  big_integer a = 5;
+  big_integer b = 3;
+  big_integer c = (big_integer(1) << 40) + 7;
+  EXPECT_EQ(0u, allocations_during([&] {
+    a += b;
+    a *= b;
+    c += b;
+    c *= b;
+  }));
+  EXPECT_EQ(24, a);
+  EXPECT_EQ(((big_integer(1) << 40) + 10) * 3, c);
+}
+
+TEST(allocations, comparisons) {
+  big_integer a = (big_integer(1) << 200) + 12345;
+  big_integer b = -a;
+  big_integer c = a;
+  bool ordered = false;
+  EXPECT_EQ(0u, allocations_during([&] {
+    ordered = b < a && a > b && b <= c && a >= c && a == c && a != b && a != 0 && b < 0;
+  }));
+  EXPECT_TRUE(ordered);
+}
+
+TEST(allocations, small_operands) {
+  big_integer a = 1000;
+  big_integer b = -7;
+  big_integer c = (big_integer(1) << 40) + 3;
+  big_integer d = -(big_integer(1) << 33);
+  bool ordered = false;
+  EXPECT_EQ(0u, allocations_during([&] {
+    a -= b;
+    a += b;
+    a *= b;
+    a -= b;
+    c -= d;
+    c += d;
+    c *= b;
+    ordered = a < b && c < d && d < a && b <= b && c != d && a == a && d != 0 && c < 0;
+  }));
+  EXPECT_TRUE(ordered);
+  EXPECT_EQ(-6993, a);
+  EXPECT_EQ(-7 * ((big_integer(1) << 40) + 3), c);
+}
+
+TEST(correctness, stream_extraction) {
+  std::istringstream in("  123\t-456 +789\n-0 -x");
+  big_integer a, b, c, d, e = 1;
+  in >> a >> b >> c >> d;
+  EXPECT_TRUE(in.good());
+  EXPECT_EQ(123, a);
+  EXPECT_EQ(-456, b);
+  EXPECT_EQ(789, c);
+  EXPECT_EQ(0, d);
+  EXPECT_FALSE(in >> e);
+  EXPECT_EQ(0, e);
+}
+
+TEST(correctness, stream_extraction_across_blocks) {
+  const size_t block = decimal::accumulator::BLOCK_DIGITS;
+  std::mt19937 gen(48);
+  for (size_t count : {block - 1, block, block + 1, 3 * block + 17, 6 * block}) {
+    std::string digits(count, '0');
+    for (size_t i = 0; i < count; i++) {
+      // A block of zeros in the middle, after a leading zero.
+      if (i > 0 && (i < block || i >= 2 * block)) {
+        digits[i] = static_cast<char>('0' + gen() % 10);
+      }
+    }
+    std::istringstream in("-" + digits + " 5");
+    big_integer a, b;
+    in >> a >> b;
+    EXPECT_EQ(big_integer("-" + digits), a);
+    EXPECT_EQ(5, b);
+    EXPECT_TRUE(in.eof());
+  }
+}
+
+// Hands out text a few characters at a time through a small get area, or one character at a
+// time without any get area at all.
+struct trickle_buffer : std::streambuf {
+  trickle_buffer(std::string text, size_t step) : text(std::move(text)), step(step) {}
+
+  int_type underflow() override {
+    if (position == text.size()) {
+      return traits_type::eof();
+    }
+    if (step == 0) {
+      return traits_type::to_int_type(text[position]);
+    }
+    size_t count = std::min(step, text.size() - position);
+    setg(&text[position], &text[position], &text[position] + count);
+    position += count;
+    return traits_type::to_int_type(*gptr());
+  }
+
+  int_type uflow() override {
+    if (step > 0) {
+      return std::streambuf::uflow();
+    }
+    return position == text.size() ? traits_type::eof() : traits_type::to_int_type(text[position++]);
+  }
+
+  std::string text;
+  size_t step;
+  size_t position = 0;
+};
+
+TEST(correctness, stream_extraction_across_refills) {
+  std::string digits = "98765432109876543210987654321";
+  for (size_t step : {0, 1, 3, 7, 64}) {
+    trickle_buffer buffer(" -" + digits + "+12x", step);
+    std::istream in(&buffer);
+    big_integer a, b;
+    in >> a >> b;
+    EXPECT_EQ(big_integer("-" + digits), a);
+    EXPECT_EQ(12, b);
+    EXPECT_EQ('x', in.get());
+    EXPECT_FALSE(in >> a);
+    EXPECT_TRUE(in.eof());
+  }
+}
+
+TEST(correctness, to_chars_matches_horner) {
+  std::mt19937 gen(49);
+  char buffer[4096];
+  for (int base : {2, 3, 7, 8, 10, 16, 32, 36}) {
+    for (size_t length : {0, 1, 2, 5, 20, 70}) {
+      big_integer a;
+      for (size_t i = 0; i < length; i++) {
+        a = (a << 32) + static_cast<unsigned>(gen());
+      }
+      a = gen() % 2 ? -a : a;
+      size_t bound = max_digits(a, base);
+      ASSERT_LE(bound, sizeof(buffer));
+      std::to_chars_result result = to_chars(buffer, buffer + bound, a, base);
+      ASSERT_EQ(std::errc(), result.ec);
+      char const* digits = buffer + (buffer[0] == '-');
+      EXPECT_TRUE(*digits != '0' || a == 0);
+      big_integer parsed;
+      for (char const* p = digits; p != result.ptr; p++) {
+        parsed = parsed * base + static_cast<int>(*p <= '9' ? *p - '0' : *p - 'a' + 10);
+      }
+      EXPECT_EQ(a, buffer[0] == '-' ? -parsed : parsed);
+      if (base == 10) {
+        EXPECT_EQ(to_string(a), std::string(buffer, result.ptr));
+      }
+    }
+  }
+}
+
+TEST(correctness, to_chars_errors) {
+  big_integer a("-1234567890123456789012345678901234567890");
+  char buffer[64];
+  std::to_chars_result exact = to_chars(buffer, buffer + 41, a);
+  EXPECT_EQ(std::errc(), exact.ec);
+  EXPECT_EQ(buffer + 41, exact.ptr);
+  EXPECT_EQ(std::errc::value_too_large, to_chars(buffer, buffer + 40, a).ec);
+  EXPECT_EQ(std::errc::invalid_argument, to_chars(buffer, buffer + 64, a, 37).ec);
+  EXPECT_EQ(std::errc::value_too_large, to_chars(buffer, buffer, big_integer()).ec);
+}
+
+TEST(correctness, stream_insertion_formatting) {
+  std::ostringstream out;
+  out << big_integer(-42) << ' ' << std::setw(6) << std::setfill('*') << big_integer(-42) << ' '
+      << std::left << std::setw(6) << big_integer(-42) << ' ' << std::internal << std::setw(6) << big_integer(-42)
+      << ' ' << std::setw(2) << big_integer(12345);
+  EXPECT_EQ("-42 ***-42 -42*** -***42 12345", out.str());
+}
+
+TEST(correctness, stream_insertion_bases) {
+  std::ostringstream out;
+  big_integer a = (big_integer(0xabc) << 64) + 255;
+  out << std::hex << a << ' ' << -a << ' ' << std::showbase << std::uppercase << a << ' ' << std::oct << big_integer(8)
+      << ' ' << big_integer(0) << ' ' << std::dec << std::showpos << big_integer(7) << ' ' << big_integer(0) << ' '
+      << std::setw(6) << std::internal << std::setfill('0') << big_integer(-7) << ' ' << std::noshowpos << std::hex
+      << std::setw(8) << a % 4096;
+  EXPECT_EQ("abc00000000000000ff -abc00000000000000ff 0XABC00000000000000FF 010 0 +7 +0 -00007 0X0000FF", out.str());
+}
+
+// Long numbers go to the stream a piece at a time; runs of zeros between pieces must survive.
+TEST(correctness, stream_insertion_of_long_numbers) {
+  std::mt19937 gen(49);
+  for (size_t length : {100, 150, 1000, 3000}) {
+    big_integer a;
+    for (size_t i = 0; i < length; i++) {
+      a = (a << 32) + static_cast<unsigned>(i % 7 == 3 || i % 5 == 1 ? 0 : gen());
+    }
+    a = -(a * big_integer(std::string("1" + std::string(2000, '0'))) + 1);
+    std::string decimal = to_string(a);
+    std::ostringstream out;
+    out << std::setw(static_cast<int>(decimal.size() + 3)) << a << std::left << std::setw(4) << ' ' << a << '|';
+    EXPECT_EQ("   " + decimal + "    " + decimal + "|", out.str());
+    for (int base : {8, 16}) {
+      std::vector<char> expected(max_digits(a, base));
+      std::to_chars_result result = to_chars(expected.data(), expected.data() + expected.size(), a, base);
+      std::ostringstream based;
+      based << std::setbase(base) << std::internal << std::setfill('#')
+            << std::setw(static_cast<int>(result.ptr - expected.data() + 2)) << a;
+      EXPECT_EQ("-##" + std::string(expected.data() + 1, result.ptr), based.str());
+    }
+  }
+}
+
+TEST(allocations, to_chars_of_short_numbers) {
+  big_integer a = -((big_integer(1) << 90) + 12345);
+  char buffer[64];
+  std::to_chars_result result;
+  EXPECT_EQ(0u, allocations_during([&] {
+    result = to_chars(buffer, buffer + max_digits(a), a);
+  }));
+  EXPECT_EQ(to_string(a), std::string(buffer, result.ptr));
+}
+
+// The longest decimal numbers that are still formatted by the quadratic base case.
+TEST(allocations, to_chars_at_base_case_bound) {
+  big_integer a = -big_integer(std::string(134, '9'));
+  EXPECT_LT(-a, big_integer(1) << 448);
+  char buffer[256];
+  std::to_chars_result result;
+  EXPECT_EQ(0u, allocations_during([&] {
+    result = to_chars(buffer, buffer + max_digits(a), a);
+  }));
+  EXPECT_EQ(to_string(a), std::string(buffer, result.ptr));
+}
+
+TEST(hash, equal_values_hash_equal) {
+  std::hash<big_integer> h;
+  big_integer a("123456789012345678901234567890123456789");
+  big_integer b = (a + 1) - 1;
+  big_integer c = a;
+  c.reserve(4096);
+  EXPECT_EQ(h(a), h(b));
+  EXPECT_EQ(h(a), h(c));
+  EXPECT_EQ(h(big_integer()), h(-big_integer()));
+  EXPECT_NE(h(a), h(-a));
+  EXPECT_NE(h(a), h(a + 1));
+  EXPECT_NE(h(big_integer(1) << 32), h(big_integer(1) << 64));
+}
+
+// The same value in both implementations, so hashes agree between them.
+TEST(hash, matches_across_implementations) {
+  if (sizeof(size_t) < 8) {
+    return;
+  }
+  std::hash<big_integer> h;
+  EXPECT_EQ(8717692274220506808u, h(big_integer("-98765432109876543210987654321")));
+}
+
+TEST(hash, unordered_map_keys) {
+  std::unordered_map<big_integer, int> map;
+  for (int i = 0; i < 1000; i++) {
+    map[(big_integer(i) << 100) - i] = i;
+  }
+  EXPECT_EQ(1000u, map.size());
+  for (int i = 0; i < 1000; i++) {
+    auto it = map.find((big_integer(i) << 100) - i);
+    ASSERT_NE(map.end(), it);
+    EXPECT_EQ(i, it->second);
+  }
+  EXPECT_EQ(map.end(), map.find(big_integer(1) << 100));
+}
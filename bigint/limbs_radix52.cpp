@@ -0,0 +1,154 @@
+#include "limbs.h"
+
+#include <algorithm>
+#include <vector>
+
+#if defined(__x86_64__) && defined(__GNUC__)
+#define BIGINT_IFMA
+#include <immintrin.h>
+#endif
+
+// Operands are split into 52-bit digits, which is what vpmadd52luq/vpmadd52huq multiply:
+// each adds the low (or high) 52 bits of a 104-bit digit product to a 64-bit accumulator.
+// Columns are computed eight at a time (one zmm register), so a column collects at most
+// 2 * RADIX52_MAX_LIMBS * 32 / 52 products and never overflows before the final carry pass.
+namespace {
+const unsigned DIGIT_BITS = 52;
+const uint64_t DIGIT_MASK = (static_cast<uint64_t>(1) << DIGIT_BITS) - 1;
+const size_t LANES = 8;
+
+uint64_t limb_at(uint32_t const* a, size_t n, size_t i) {
+    return i < n ? a[i] : 0;
+}
+
+size_t digits_for(size_t n) {
+    return (n * 32 + DIGIT_BITS - 1) / DIGIT_BITS;
+}
+
+void to_radix52(uint64_t* r, uint32_t const* a, size_t n) {
+    for (size_t j = 0; j < digits_for(n); j++) {
+        size_t q = j * DIGIT_BITS / 32;
+        unsigned offset = j * DIGIT_BITS % 32;
+        uint64_t digit = (limb_at(a, n, q) | limb_at(a, n, q + 1) << 32) >> offset;
+        if (offset > 0) {
+            digit |= limb_at(a, n, q + 2) << (64 - offset);
+        }
+        r[j] = digit & DIGIT_MASK;
+    }
+}
+
+// c holds digits below 2^52 after the carry pass.
+void from_radix52(uint32_t* r, size_t n, uint64_t const* c) {
+    for (size_t i = 0; i < n; i++) {
+        size_t q = i * 32 / DIGIT_BITS;
+        unsigned offset = i * 32 % DIGIT_BITS;
+        r[i] = static_cast<uint32_t>((c[q] >> offset) | (c[q + 1] << (DIGIT_BITS - offset)));
+    }
+}
+
+// What vpmadd52luq/vpmadd52huq compute for one lane, from 26-bit halves of the digits.
+void madd52(uint64_t& lo, uint64_t& hi, uint64_t x, uint64_t y) {
+    const uint64_t half_mask = (static_cast<uint64_t>(1) << (DIGIT_BITS / 2)) - 1;
+    uint64_t x0 = x & half_mask;
+    uint64_t x1 = x >> (DIGIT_BITS / 2);
+    uint64_t y0 = y & half_mask;
+    uint64_t y1 = y >> (DIGIT_BITS / 2);
+    uint64_t middle = x1 * y0 + x0 * y1;
+    uint64_t low = x0 * y0 + ((middle & half_mask) << (DIGIT_BITS / 2));
+    lo += low & DIGIT_MASK;
+    hi += x1 * y1 + (middle >> (DIGIT_BITS / 2)) + (low >> DIGIT_BITS);
+}
+
+// Same lanes and accumulation order as the IFMA loop, one lane at a time.
+void columns_scalar(uint64_t* lo, uint64_t* hi, uint64_t const* a, size_t begin, size_t end,
+                    uint64_t const* b, size_t t) {
+    for (size_t i = begin; i < end; i++) {
+        for (size_t lane = 0; lane < LANES; lane++) {
+            madd52(lo[lane], hi[lane], a[i], (b - i)[t + lane]);
+        }
+    }
+}
+
+#ifdef BIGINT_IFMA
+__attribute__((target("avx512f,avx512ifma")))
+void columns_ifma(uint64_t* lo, uint64_t* hi, uint64_t const* a, size_t begin, size_t end,
+                  uint64_t const* b, size_t t) {
+    __m512i acc_lo = _mm512_setzero_si512();
+    __m512i acc_hi = _mm512_setzero_si512();
+    for (size_t i = begin; i < end; i++) {
+        __m512i digit = _mm512_set1_epi64(static_cast<long long>(a[i]));
+        __m512i other = _mm512_loadu_si512(b - i + t);
+        acc_lo = _mm512_madd52lo_epu64(acc_lo, digit, other);
+        acc_hi = _mm512_madd52hi_epu64(acc_hi, digit, other);
+    }
+    _mm512_storeu_si512(lo, acc_lo);
+    _mm512_storeu_si512(hi, acc_hi);
+}
+#endif
+
+bool ifma_on = false;
+
+bool const ifma_detected = limbs::use_ifma(limbs::ifma_supported());
+}
+
+void limbs::mul_radix52(uint32_t* r, uint32_t const* a, size_t n, uint32_t const* b, size_t m, bool ifma) {
+    size_t k = digits_for(n);
+    size_t l = digits_for(m);
+    // b is surrounded by zeros, so that every lane may read b[t + lane - i] for any i < k;
+    // only digits i of a that meet some digit of b in columns [t, t + LANES) are visited.
+    size_t width = (k + l + LANES - 1) / LANES * LANES;
+    std::vector<uint64_t> x(k);
+    std::vector<uint64_t> y(k + width + LANES);
+    std::vector<uint64_t> c(width + LANES + 1);
+    to_radix52(x.data(), a, n);
+    to_radix52(y.data() + k, b, m);
+    uint64_t const* shifted = y.data() + k;
+    uint64_t lo[LANES];
+    uint64_t hi[LANES];
+    for (size_t t = 0; t < width; t += LANES) {
+        std::fill(lo, lo + LANES, 0);
+        std::fill(hi, hi + LANES, 0);
+        size_t begin = t + 1 > l ? t + 1 - l : 0;
+        size_t end = std::min(k, t + LANES);
+#ifdef BIGINT_IFMA
+        if (ifma) {
+            columns_ifma(lo, hi, x.data(), begin, end, shifted, t);
+        } else {
+            columns_scalar(lo, hi, x.data(), begin, end, shifted, t);
+        }
+#else
+        columns_scalar(lo, hi, x.data(), begin, end, shifted, t);
+#endif
+        for (size_t lane = 0; lane < LANES; lane++) {
+            c[t + lane] += lo[lane];
+            c[t + lane + 1] += hi[lane];
+        }
+    }
+    uint64_t carry = 0;
+    for (uint64_t& digit : c) {
+        digit += carry;
+        carry = digit >> DIGIT_BITS;
+        digit &= DIGIT_MASK;
+    }
+    from_radix52(r, n + m, c.data());
+}
+
+bool limbs::ifma_supported() {
+#ifdef BIGINT_IFMA
+    return __builtin_cpu_supports("avx512ifma");
+#else
+    return false;
+#endif
+}
+
+bool limbs::ifma_enabled() {
+    return ifma_on;
+}
+
+bool limbs::use_ifma(bool enabled) {
+    if (enabled && !ifma_supported()) {
+        return false;
+    }
+    ifma_on = enabled;
+    return true;
+}
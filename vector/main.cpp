@@ -1,5 +1,7 @@
 #include "vector.h"
 #include "gtest/gtest.h"
+#include <cstdlib>
+#include <new>
 #include <unordered_set>
 
 template
@@ -10,6 +12,27 @@ T const& as_const(T& obj) {
   return obj;
 }
 
+// Every global allocation of the thread is counted, so that tests can assert that an operation
+// does not allocate. Kept out of line: once inlined, GCC pairs new expressions with the free
+// inside and reports a mismatch.
+static thread_local size_t allocations = 0;
+
+__attribute__((noinline)) void* operator new(size_t size) {
+  allocations++;
+  if (void* p = std::malloc(size == 0 ? 1 : size)) {
+    return p;
+  }
+  throw std::bad_alloc();
+}
+
+__attribute__((noinline)) void operator delete(void* p) noexcept {
+  std::free(p);
+}
+
+__attribute__((noinline)) void operator delete(void* p, size_t) noexcept {
+  std::free(p);
+}
+
 template<typename T>
 struct element {
   element() {
@@ -500,3 +523,15 @@ TEST(correctness, ctor_alloc) {
   EXPECT_EQ(1, b.capacity());
 }
 
+TEST(correctness, push_back_within_capacity_does_not_allocate) {
+  size_t const N = 100;
+  vector<size_t> a;
+  a.reserve(N);
+  size_t before = allocations;
+  for (size_t i = 0; i != N; ++i)
+    a.push_back(i);
+  a.pop_back();
+  a.push_back(N);
+  EXPECT_EQ(before, allocations);
+  EXPECT_EQ(N, a.capacity());
+}